@@ -120,6 +120,7 @@ disk_init (void) {
 				NOT_REACHED ();
 		}
 		lock_init (&c->lock);
+		lockstat_register (&c->lock, "disk %s", c->name);
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
 
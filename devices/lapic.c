@@ -0,0 +1,208 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC.  See [IA32-v3a] chapter 10 "Advanced Programmable
+   Interrupt Controller (APIC)".
+
+   Each CPU has its own local APIC, reached through a page of
+   memory-mapped registers at the same physical address on every
+   CPU.  External interrupts keep arriving through the 8259A PIC
+   in virtual wire mode, as set up by the BIOS; the local APIC is
+   used only for its timer.
+
+   The timer counts down from an initial count at a fixed rate,
+   which lapic_timer_calibrate_*() measure, and interrupts when it
+   reaches zero, once or periodically.  Where the CPU supports
+   it, it can instead interrupt when the TSC reaches a deadline
+   written to an MSR, which needs no calibration and no
+   conversion at all. */
+
+/* IA32_APIC_BASE model-specific register. */
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_ENABLE (1 << 11)      /* xAPIC global enable. */
+#define APIC_BASE_ADDR 0xfffff000       /* Physical base address. */
+
+/* IA32_TSC_DEADLINE model-specific register. */
+#define MSR_TSC_DEADLINE 0x6e0
+
+/* CPUID.01H:EDX bit reporting an on-chip APIC, and CPUID.01H:ECX
+   bit reporting TSC-deadline mode for its timer. */
+#define CPUID_APIC (1 << 9)
+#define CPUID_TSC_DEADLINE (1 << 24)
+
+/* Register offsets, in bytes. */
+#define LAPIC_ID     0x020              /* Local APIC ID. */
+#define LAPIC_TPR    0x080              /* Task priority. */
+#define LAPIC_EOI    0x0b0              /* End of interrupt. */
+#define LAPIC_SVR    0x0f0              /* Spurious interrupt vector. */
+#define LAPIC_LVT_TIMER 0x320           /* Timer local vector table entry. */
+#define LAPIC_TIMER_ICR 0x380           /* Timer initial count. */
+#define LAPIC_TIMER_CCR 0x390           /* Timer current count. */
+#define LAPIC_TIMER_DCR 0x3e0           /* Timer divide configuration. */
+
+#define SVR_ENABLE (1 << 8)             /* APIC software enable. */
+#define LVT_MASKED (1 << 16)            /* Interrupt masked. */
+#define LVT_ONESHOT (0 << 17)           /* Timer mode: one-shot. */
+#define LVT_PERIODIC (1 << 17)          /* Timer mode: periodic. */
+#define LVT_TSC_DEADLINE (2 << 17)      /* Timer mode: TSC deadline. */
+#define DCR_DIVIDE_1 0xb                /* Count at the full timer clock. */
+
+/* Kernel virtual address of the register page, or a null
+   pointer if there is no usable local APIC. */
+static volatile uint32_t *lapic;
+
+static intr_handler_func spurious_interrupt;
+
+/* Reads local APIC register REG. */
+static uint32_t
+lapic_read (int reg) {
+	return lapic[reg / 4];
+}
+
+/* Writes VALUE to local APIC register REG, then waits for the
+   write to complete by reading the ID register back. */
+static void
+lapic_write (int reg, uint32_t value) {
+	lapic[reg / 4] = value;
+	(void) lapic[LAPIC_ID / 4];
+}
+
+/* Maps the local APIC's registers into the kernel address space
+   and software-enables it.  Returns false, leaving the APIC
+   alone, if the CPU does not have one. */
+bool
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t base, *pte;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_APIC))
+		return false;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (!(base & APIC_BASE_ENABLE))
+		return false;
+	base &= APIC_BASE_ADDR;
+
+	/* The register page lies above RAM, outside the range that
+	   paging_init() maps, so map it here, uncached. */
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (base), 1);
+	if (pte == NULL)
+		PANIC ("lapic_init: cannot map local APIC registers");
+	*pte = base | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) ptov (base));
+	lapic = ptov (base);
+
+	intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF, spurious_interrupt,
+			"LAPIC Spurious");
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_TPR, 0);
+	return true;
+}
+
+/* Returns true if lapic_init() found and enabled a local APIC. */
+bool
+lapic_present (void) {
+	return lapic != NULL;
+}
+
+/* Signals the end of an interrupt delivered by the local APIC. */
+void
+lapic_eoi (void) {
+	if (lapic != NULL)
+		lapic_write (LAPIC_EOI, 0);
+}
+
+/* Returns true if the local APIC timer supports TSC-deadline
+   mode. */
+bool
+lapic_timer_has_deadline (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	if (lapic == NULL)
+		return false;
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	return (ecx & CPUID_TSC_DEADLINE) != 0;
+}
+
+/* Starts the local APIC timer counting down from its largest
+   count, without interrupting, so that the count that
+   lapic_timer_calibrate_end() returns measures the time in
+   between. */
+void
+lapic_timer_calibrate_start (void) {
+	ASSERT (lapic != NULL);
+
+	lapic_write (LAPIC_TIMER_DCR, DCR_DIVIDE_1);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LVT_ONESHOT | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, UINT32_MAX);
+}
+
+/* Stops the count started by lapic_timer_calibrate_start() and
+   returns how far it got. */
+uint32_t
+lapic_timer_calibrate_end (void) {
+	uint32_t count = UINT32_MAX - lapic_read (LAPIC_TIMER_CCR);
+
+	lapic_timer_stop ();
+	return count;
+}
+
+/* Makes the local APIC timer interrupt every COUNT counts. */
+void
+lapic_timer_periodic (uint32_t count) {
+	ASSERT (lapic != NULL);
+	ASSERT (count > 0);
+
+	lapic_write (LAPIC_TIMER_DCR, DCR_DIVIDE_1);
+	lapic_write (LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, count);
+}
+
+/* Makes the local APIC timer interrupt once, COUNT counts from
+   now. */
+void
+lapic_timer_oneshot (uint32_t count) {
+	ASSERT (lapic != NULL);
+	ASSERT (count > 0);
+
+	lapic_write (LAPIC_TIMER_DCR, DCR_DIVIDE_1);
+	lapic_write (LAPIC_LVT_TIMER, LVT_ONESHOT | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, count);
+}
+
+/* Makes the local APIC timer interrupt once the TSC reaches
+   DEADLINE, at once if it already has.  The timer must support
+   TSC-deadline mode. */
+void
+lapic_timer_deadline (uint64_t deadline) {
+	ASSERT (lapic != NULL);
+
+	if ((lapic_read (LAPIC_LVT_TIMER) & (3 << 17)) != LVT_TSC_DEADLINE) {
+		lapic_write (LAPIC_LVT_TIMER, LVT_TSC_DEADLINE | LAPIC_TIMER_VEC);
+		/* The mode change must take effect before the MSR write. */
+		asm volatile ("mfence" : : : "memory");
+	}
+	write_msr (MSR_TSC_DEADLINE, deadline != 0 ? deadline : 1);
+}
+
+/* Stops the local APIC timer. */
+void
+lapic_timer_stop (void) {
+	ASSERT (lapic != NULL);
+
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TIMER_ICR, 0);
+}
+
+/* Spurious interrupts need neither handling nor an EOI. */
+static void
+spurious_interrupt (struct intr_frame *f UNUSED) {
+}
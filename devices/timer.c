@@ -1,75 +1,425 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <intrinsic.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/sched_trace.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
-#if TIMER_FREQ < 19
-#error 8254 timer requires TIMER_FREQ >= 19
-#endif
-#if TIMER_FREQ > 1000
-#error TIMER_FREQ <= 1000 recommended
-#endif
+/* Number of timer interrupts per second. */
+unsigned timer_freq = 100;
+
+/* Device to drive the timer tick once calibrated. */
+enum timer_source timer_source = TIMER_PIT;
 
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
-
+/* Time stamp counter clock.  timer_calibrate() counts TSC
+   cycles across a few timer ticks, after which the TSC serves
+   as the monotonic clock, for timer_clock_ns(), and as the time
+   base for high-resolution timers. */
+#define NSEC_PER_SEC 1000000000
+#define CALIBRATE_TICKS ((TIMER_FREQ + 19) / 20)
+static uint64_t tsc_hz;         /* TSC cycles per second, or 0. */
+static uint64_t tsc_per_tick;   /* TSC cycles per timer tick. */
+static uint64_t tsc_boot;       /* TSC at timer_init(). */
+static uint64_t last_tick_tsc;  /* TSC at the latest tick. */
+
+/* 8254 input frequency. */
+#define PIT_HZ 1193180
+
+/* Local APIC timer counts per second, measured along with
+   tsc_hz, or 0 without a local APIC. */
+static uint64_t lapic_hz;
+
+/* Clock event devices.
+
+   The timer interrupt is raised by a clock event device, either
+   once per tick or once when the TSC reaches a deadline.  The
+   8254 starts out as the device, because the others can only be
+   programmed once the TSC has been calibrated against it;
+   timer_calibrate() then switches to the device that
+   timer_source selects, falling back to what the CPU has. */
+struct clockevent {
+	const char *name;
+	void (*set_periodic) (void);    /* Null if only one-shot. */
+	void (*set_oneshot) (uint64_t deadline, uint64_t now);
+	void (*stop) (void);
+	uint64_t (*max_cycles) (void);  /* Longest one-shot, in TSC cycles. */
+};
+
+static void pit_set_periodic (void);
+static void pit_set_oneshot (uint64_t deadline, uint64_t now);
+static void pit_stop (void);
+static uint64_t pit_max_cycles (void);
+static void lapic_set_periodic (void);
+static void lapic_set_oneshot (uint64_t deadline, uint64_t now);
+static uint64_t lapic_max_cycles (void);
+static void deadline_set_oneshot (uint64_t deadline, uint64_t now);
+static uint64_t deadline_max_cycles (void);
+
+static const struct clockevent pit_clockevent = {
+	"8254 PIT", pit_set_periodic, pit_set_oneshot, pit_stop, pit_max_cycles,
+};
+static const struct clockevent lapic_clockevent = {
+	"local APIC timer", lapic_set_periodic, lapic_set_oneshot,
+	lapic_timer_stop, lapic_max_cycles,
+};
+static const struct clockevent deadline_clockevent = {
+	"local APIC timer in TSC-deadline mode", NULL, deadline_set_oneshot,
+	lapic_timer_stop, deadline_max_cycles,
+};
+
+static const struct clockevent *clockevent = &pit_clockevent;
+static bool oneshot;            /* Armed one-shot instead of ticking? */
+
+/* Tickless idle.  If timer_tickless is set, the idle thread
+   arms a one-shot countdown that lasts until the next pending
+   timer event (bounded by what the device can count) instead of
+   taking an interrupt every tick.  The first external interrupt
+   afterward catches up `ticks' from the TSC. */
+bool timer_tickless;
+static bool tick_stopped;       /* Idle countdown in progress? */
+static long long skipped_ticks; /* # of tick interrupts avoided. */
+static long long idle_stops;    /* # of times the tick was stopped. */
+
+/* High-resolution timers.
+
+   Pending hrtimers wait in a heap ordered by expiry time.  While
+   the earliest one expires before the next tick, the clock event
+   device is armed for it instead of for the tick; the interrupt
+   that follows fires the hrtimers that are due, counts a tick
+   only if the TSC says that one is due, and arms the device for
+   whatever comes next, going back to periodic ticks once no
+   hrtimer is due before the next tick.  Unlike timer events,
+   hrtimers fire in the timer interrupt itself, so that their
+   latency does not depend on other deferred work.
+
+   Sleeps shorter than HRTIMER_MIN_NS spin on the TSC instead,
+   because blocking and reprogramming the device costs about as
+   much.  Timers within HRTIMER_SLACK_NS of expiring fire early,
+   rather than a countdown too short for the device. */
+#define HRTIMER_MIN_NS 20000
+#define HRTIMER_SLACK_NS 1000
+static struct pqueue hrtimers;  /* Pending hrtimers, earliest on top. */
+static long long hrtimer_shots; /* # of one-shots armed for hrtimers. */
+
+/* TSC cycles spent in timer_interrupt(), for measuring how the
+   cost of a tick scales with the number of threads.  The work
+   that the interrupt defers is counted by softirq_cycles(). */
+static uint64_t interrupt_cycles;
+
+
+/* Timer wheel.
+
+   Pending timer events live in a hierarchical timing wheel of
+   WHEEL_LEVELS levels with WHEEL_SIZE slots each.  An event due
+   within WHEEL_SIZE ticks sits in the level-0 slot picked by the
+   low bits of its deadline.  Events further out sit in coarser
+   levels and are cascaded one level down whenever the level
+   below wraps around.  Adding or cancelling an event is O(1),
+   and each tick only touches the events that expire on it, plus
+   an amortized share of the cascades.
+
+   The timer interrupt itself only queues wheel_work.  That work
+   fires the expired events one at a time, turning interrupts
+   back on between them, so that a tick with many expiring
+   events does not keep interrupts off for all of them. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1LL << (WHEEL_BITS * WHEEL_LEVELS))
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_tick;      /* Next tick the wheel will process. */
+static size_t wheel_pending;    /* Number of events in the wheel. */
+static struct list wheel_expired; /* Detached, due, not yet fired. */
+static struct work wheel_work;  /* Fires expired events. */
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static uint64_t ns_to_tsc (uint64_t ns);
+static uint64_t tsc_to_ns (uint64_t cycles);
+static uint64_t scale (uint64_t x, uint64_t mul, uint64_t div);
+static pq_less_func hrtimer_later;
+static void hrtimer_expire (uint64_t now);
+static bool hrtimer_due_before (uint64_t deadline);
+static void clockevent_select (void);
+static void clockevent_reprogram (uint64_t now);
+static void clockevent_oneshot (uint64_t deadline, uint64_t now);
+static void timer_tick (void);
+static hrtimer_func hrtimer_wake;
+static void wheel_insert (struct timer_event *);
+static void wheel_advance (int64_t now);
+static work_func wheel_run;
+static int64_t wheel_next_deadline (void);
 
-extern unsigned global_tick;
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
+   interrupt TIMER_FREQ times per second, and registers the
    corresponding interrupt. */
 void
 timer_init (void) {
+	int level, slot;
+
+	if (timer_freq < 19 || timer_freq > 1000)
+		PANIC ("timer frequency %u Hz out of range 19...1000", timer_freq);
+
+	for (level = 0; level < WHEEL_LEVELS; level++)
+		for (slot = 0; slot < WHEEL_SIZE; slot++)
+			list_init (&wheel[level][slot]);
+	list_init (&wheel_expired);
+	work_init (&wheel_work, wheel_run, NULL);
+	pq_init (&hrtimers, hrtimer_later, NULL);
+
+	tsc_boot = last_tick_tsc = rdtsc ();
+	pit_set_periodic ();
+	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+	if (lapic_present ())
+		intr_register_ext (LAPIC_TIMER_VEC, timer_interrupt, "LAPIC Timer");
+}
+
+/* Programs 8254 counter 0 to interrupt TIMER_FREQ times per
+   second. */
+static void
+pit_set_periodic (void) {
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
 	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	uint16_t count = (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ;
 
 	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
 	outb (0x40, count & 0xff);
 	outb (0x40, count >> 8);
+}
 
-	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+/* Programs 8254 counter 0 to interrupt once, when the TSC,
+   which reads NOW, reaches DEADLINE. */
+static void
+pit_set_oneshot (uint64_t deadline, uint64_t now) {
+	uint64_t count = deadline > now ? scale (deadline - now, PIT_HZ, tsc_hz) : 0;
+
+	if (count < 2)
+		count = 2;
+	else if (count > 0xffff)
+		count = 0xffff;
+
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Stops 8254 counter 0.  In mode 0, the counter waits for a new
+   count after the control word, with its output low. */
+static void
+pit_stop (void) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+}
+
+/* Returns the longest one-shot countdown of the 8254. */
+static uint64_t
+pit_max_cycles (void) {
+	return scale (0xffff, tsc_hz, PIT_HZ);
+}
+
+/* Programs the local APIC timer to interrupt TIMER_FREQ times
+   per second. */
+static void
+lapic_set_periodic (void) {
+	lapic_timer_periodic ((lapic_hz + TIMER_FREQ / 2) / TIMER_FREQ);
+}
+
+/* Programs the local APIC timer to interrupt once, when the
+   TSC, which reads NOW, reaches DEADLINE. */
+static void
+lapic_set_oneshot (uint64_t deadline, uint64_t now) {
+	uint64_t count = deadline > now ? scale (deadline - now, lapic_hz, tsc_hz) : 0;
+
+	if (count < 1)
+		count = 1;
+	else if (count > UINT32_MAX)
+		count = UINT32_MAX;
+	lapic_timer_oneshot (count);
+}
+
+/* Returns the longest one-shot countdown of the local APIC
+   timer. */
+static uint64_t
+lapic_max_cycles (void) {
+	return scale (UINT32_MAX, tsc_hz, lapic_hz);
+}
+
+/* Arms the local APIC timer's TSC deadline. */
+static void
+deadline_set_oneshot (uint64_t deadline, uint64_t now UNUSED) {
+	lapic_timer_deadline (deadline);
+}
+
+/* A TSC deadline may be arbitrarily far away, but an hour is
+   as good as forever and cannot overflow. */
+static uint64_t
+deadline_max_cycles (void) {
+	return tsc_hz * 3600;
+}
+
+/* Switches the timer tick to the device that timer_source asks
+   for, or the best one available.  Interrupts must be off, and
+   the TSC must be calibrated. */
+static void
+clockevent_select (void) {
+	const struct clockevent *ce = &pit_clockevent;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (timer_source == TIMER_DEADLINE && lapic_timer_has_deadline ())
+		ce = &deadline_clockevent;
+	else if (timer_source != TIMER_PIT && lapic_hz != 0)
+		ce = &lapic_clockevent;
+	if (ce == clockevent)
+		return;
+
+	clockevent->stop ();
+	clockevent = ce;
+	last_tick_tsc = rdtsc ();
+	if (ce->set_periodic != NULL) {
+		ce->set_periodic ();
+		oneshot = false;
+	} else
+		clockevent_oneshot (last_tick_tsc + tsc_per_tick, last_tick_tsc);
+}
+
+/* Arms the clock event device to interrupt once, when the TSC,
+   which reads NOW, reaches DEADLINE. */
+static void
+clockevent_oneshot (uint64_t deadline, uint64_t now) {
+	clockevent->set_oneshot (deadline, now);
+	oneshot = true;
+}
+
+/* Makes the clock event device interrupt in time for the next
+   tick and the earliest pending hrtimer, given that the TSC
+   reads NOW.  Interrupts must be off. */
+static void
+clockevent_reprogram (uint64_t now) {
+	uint64_t next_tick = last_tick_tsc + tsc_per_tick;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (tick_stopped || tsc_hz == 0)
+		return;
+	if (hrtimer_due_before (next_tick)) {
+		struct hrtimer *hr = pq_entry (pq_top (&hrtimers), struct hrtimer, elem);
+		clockevent_oneshot (hr->expires, now);
+		hrtimer_shots++;
+	} else if (oneshot)
+		clockevent_oneshot (next_tick, now);
+}
+
+/* Called by the idle thread, with interrupts off, just before
+   it halts.  If tickless idle is enabled and nothing is due for
+   at least two ticks, stops the periodic tick and arms a
+   one-shot for the next timer event or hrtimer instead. */
+void
+timer_idle_enter (void) {
+	uint64_t now, deadline;
+	int64_t idle_ticks, max_ticks;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || tsc_hz == 0 || tick_stopped || softirq_pending ())
+		return;
+
+	idle_ticks = wheel_next_deadline () - ticks;
+	max_ticks = clockevent->max_cycles () / tsc_per_tick;
+	if (idle_ticks > max_ticks)
+		idle_ticks = max_ticks;
+	if (idle_ticks < 2)
+		return;
+
+	deadline = last_tick_tsc + idle_ticks * tsc_per_tick;
+	if (hrtimer_due_before (deadline)) {
+		deadline = pq_entry (pq_top (&hrtimers), struct hrtimer, elem)->expires;
+		if (deadline < last_tick_tsc + 2 * tsc_per_tick)
+			return;
+	}
+
+	now = rdtsc ();
+	clockevent_oneshot (deadline, now);
+	tick_stopped = true;
+	idle_stops++;
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Called at the start of every external interrupt.  If the
+   periodic tick was stopped by timer_idle_enter(), accounts for
+   the whole ticks that went by and arms the device for the next
+   tick.  If this is the timer interrupt itself, it goes on to
+   count any tick that is just due. */
+void
+timer_idle_exit (void) {
+	uint64_t now;
+
+	ASSERT (intr_context ());
+
+	if (!tick_stopped)
+		return;
+	tick_stopped = false;
+
+	now = rdtsc ();
+	while (now - last_tick_tsc >= tsc_per_tick) {
+		last_tick_tsc += tsc_per_tick;
+		ticks++;
+		thread_tick ();
+		skipped_ticks++;
+	}
+	wheel_advance (ticks);
+	clockevent_reprogram (now);
+}
+
+/* Calibrates the TSC, and the local APIC timer if there is one,
+   against the timer tick, then switches the tick to the device
+   that timer_source selects. */
 void
 timer_calibrate (void) {
-	unsigned high_bit, test_bit;
+	enum intr_level old_level;
+	uint64_t start_tsc, cycles;
+	uint32_t lapic_counts = 0;
+	int64_t start;
 
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
 
-	/* Approximate loops_per_tick as the largest power-of-two
-	   still less than one timer tick. */
-	loops_per_tick = 1u << 10;
-	while (!too_many_loops (loops_per_tick << 1)) {
-		loops_per_tick <<= 1;
-		ASSERT (loops_per_tick != 0);
-	}
+	/* Count the TSC cycles and local APIC timer counts in
+	   CALIBRATE_TICKS whole ticks. */
+	start = timer_ticks ();
+	while (timer_ticks () == start)
+		barrier ();
+	start_tsc = rdtsc ();
+	if (lapic_present ())
+		lapic_timer_calibrate_start ();
+	start = timer_ticks ();
+	while (timer_ticks () < start + CALIBRATE_TICKS)
+		barrier ();
+	cycles = rdtsc () - start_tsc;
+	if (lapic_present ())
+		lapic_counts = lapic_timer_calibrate_end ();
 
-	/* Refine the next 8 bits of loops_per_tick. */
-	high_bit = loops_per_tick;
-	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-		if (!too_many_loops (high_bit | test_bit))
-			loops_per_tick |= test_bit;
+	old_level = intr_disable ();
+	tsc_per_tick = cycles / CALIBRATE_TICKS;
+	tsc_hz = tsc_per_tick * TIMER_FREQ;
+	lapic_hz = (uint64_t) lapic_counts * TIMER_FREQ / CALIBRATE_TICKS;
+	clockevent_select ();
+	intr_set_level (old_level);
 
-	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+	printf ("%'"PRIu64" TSC cycles/s.\n", tsc_hz);
+	printf ("Timer: %u Hz from the %s.\n", timer_freq, clockevent->name);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -105,6 +455,16 @@ timer_sleep (int64_t ticks) {
 	intr_set_level (old_level);	
 }
 
+/* Returns the time since the OS booted, in nanoseconds.  Once
+   the timer is calibrated, the time comes from the TSC;
+   before, it has the resolution of a timer tick. */
+uint64_t
+timer_clock_ns (void) {
+	if (tsc_hz == 0)
+		return timer_ticks () * (NSEC_PER_SEC / TIMER_FREQ);
+	return tsc_to_ns (rdtsc () - tsc_boot);
+}
+
 /* Suspends execution for approximately MS milliseconds. */
 void
 timer_msleep (int64_t ms) {
@@ -123,77 +483,396 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Returns the total number of TSC cycles spent in the timer
+   interrupt handler since boot, not counting the work it queues
+   to run after it. */
+uint64_t
+timer_interrupt_cycles (void) {
+	enum intr_level old_level = intr_disable ();
+	uint64_t cycles = interrupt_cycles;
+	intr_set_level (old_level);
+	return cycles;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
-	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	printf ("Timer: %"PRId64" ticks, %lld hrtimer countdowns\n",
+			timer_ticks (), hrtimer_shots);
+	if (timer_tickless)
+		printf ("Timer: %lld ticks skipped in %lld tickless idle periods\n",
+				skipped_ticks, idle_stops);
 }
 
 
-/* Timer interrupt handler. */
-static void
-timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
-	thread_tick ();
+/* Arranges for FUNC to be called with AUX from the timer
+   interrupt once the tick count reaches DEADLINE.  A DEADLINE
+   that has already passed fires on the next tick.  EV must not
+   already be pending. */
+void
+timer_add (struct timer_event *ev, int64_t deadline,
+		timer_func *func, void *aux) {
+	enum intr_level old_level;
 
-	int64_t curr_tick = timer_ticks ();
-	/* handles the sleep_list and the global tick */
-	thread_wakeup(curr_tick);
+	ASSERT (ev != NULL);
+	ASSERT (func != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (!ev->pending);
+	ev->deadline = deadline;
+	ev->func = func;
+	ev->aux = aux;
+	ev->pending = true;
+	wheel_pending++;
+	wheel_insert (ev);
+	intr_set_level (old_level);
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
+/* Cancels EV if it has not fired yet.  Returns true if EV was
+   pending, false if it had already fired or was never added. */
+bool
+timer_cancel (struct timer_event *ev) {
+	enum intr_level old_level;
+	bool was_pending;
+
+	ASSERT (ev != NULL);
+
+	old_level = intr_disable ();
+	was_pending = ev->pending;
+	if (was_pending) {
+		list_remove (&ev->elem);
+		ev->pending = false;
+		wheel_pending--;
+	}
+	intr_set_level (old_level);
+
+	return was_pending;
+}
+
+/* Arranges for FUNC to be called with AUX from the timer
+   interrupt once timer_clock_ns() reaches DEADLINE_NS.  A
+   deadline that has already passed fires right away, and one
+   beyond what the TSC can count to never fires.  HR must not
+   already be pending, and the timer must be calibrated. */
+void
+hrtimer_start (struct hrtimer *hr, uint64_t deadline_ns,
+		hrtimer_func *func, void *aux) {
+	enum intr_level old_level;
+
+	ASSERT (hr != NULL);
+	ASSERT (func != NULL);
+	ASSERT (tsc_hz != 0);
+
+	old_level = intr_disable ();
+	ASSERT (!hr->pending);
+	if (deadline_ns < tsc_to_ns (UINT64_MAX - tsc_boot))
+		hr->expires = tsc_boot + ns_to_tsc (deadline_ns);
+	else
+		hr->expires = UINT64_MAX;
+	hr->func = func;
+	hr->aux = aux;
+	hr->pending = true;
+	pq_push (&hrtimers, &hr->elem);
+	clockevent_reprogram (rdtsc ());
+	intr_set_level (old_level);
+}
+
+/* Cancels HR if it has not fired yet.  Returns true if HR was
+   pending, false if it had already fired or was never started. */
+bool
+hrtimer_cancel (struct hrtimer *hr) {
+	enum intr_level old_level;
+	bool was_pending;
+
+	ASSERT (hr != NULL);
+
+	old_level = intr_disable ();
+	was_pending = hr->pending;
+	if (was_pending) {
+		pq_remove (&hrtimers, &hr->elem);
+		hr->pending = false;
+	}
+	intr_set_level (old_level);
+
+	return was_pending;
+}
+
+/* Orders hrtimers so that the earliest to expire is on top. */
 static bool
-too_many_loops (unsigned loops) {
-	/* Wait for a timer tick. */
-	int64_t start = ticks;
-	while (ticks == start)
-		barrier ();
+hrtimer_later (const struct pq_elem *a_, const struct pq_elem *b_,
+		void *aux UNUSED) {
+	const struct hrtimer *a = pq_entry (a_, struct hrtimer, elem);
+	const struct hrtimer *b = pq_entry (b_, struct hrtimer, elem);
+
+	return a->expires > b->expires;
+}
+
+/* Returns true if an hrtimer is pending that expires before
+   the TSC reaches DEADLINE. */
+static bool
+hrtimer_due_before (uint64_t deadline) {
+	return (!pq_empty (&hrtimers)
+			&& pq_entry (pq_top (&hrtimers), struct hrtimer, elem)->expires < deadline);
+}
 
-	/* Run LOOPS loops. */
-	start = ticks;
-	busy_wait (loops);
+/* Fires every hrtimer that expires by NOW, plus
+   HRTIMER_SLACK_NS, in order of expiry. */
+static void
+hrtimer_expire (uint64_t now) {
+	uint64_t slack = ns_to_tsc (HRTIMER_SLACK_NS);
 
-	/* If the tick count changed, we iterated too long. */
-	barrier ();
-	return start != ticks;
+	while (!pq_empty (&hrtimers)) {
+		struct hrtimer *hr = pq_entry (pq_top (&hrtimers), struct hrtimer, elem);
+
+		if (hr->expires > now + slack)
+			break;
+		pq_pop (&hrtimers);
+		hr->pending = false;
+		hr->func (hr, hr->aux);
+	}
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Files EV into the wheel slot for its deadline, relative to
+   wheel_tick. */
+static void
+wheel_insert (struct timer_event *ev) {
+	int64_t deadline = ev->deadline;
+	int level;
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) {
-	while (loops-- > 0)
-		barrier ();
+	if (deadline < wheel_tick)
+		deadline = wheel_tick;
+	else if (deadline - wheel_tick >= WHEEL_SPAN)
+		deadline = wheel_tick + WHEEL_SPAN - 1;   /* Re-filed on cascade. */
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (deadline - wheel_tick < 1LL << (WHEEL_BITS * (level + 1)))
+			break;
+
+	list_push_back (&wheel[level][(deadline >> (WHEEL_BITS * level))
+			& WHEEL_MASK], &ev->elem);
+}
+
+/* Moves every event in SLOT of LEVEL down to the level that now
+   matches its distance from wheel_tick. */
+static void
+wheel_cascade (int level, int slot) {
+	struct list *events = &wheel[level][slot];
+	struct list moving;
+
+	list_init (&moving);
+	if (!list_empty (events))
+		list_splice (list_end (&moving), list_begin (events), list_end (events));
+
+	while (!list_empty (&moving))
+		wheel_insert (list_entry (list_pop_front (&moving),
+					struct timer_event, elem));
 }
 
-/* Sleep for approximately NUM/DENOM seconds. */
+/* Returns the earliest tick at which the wheel may have an
+   event to fire, or INT64_MAX if it is empty.
+
+   Every event due before the next level-0 wraparound is already
+   in level 0, so it suffices to scan level 0 up to that point
+   and otherwise report the wraparound itself, where a cascade
+   may bring further events into range. */
+static int64_t
+wheel_next_deadline (void) {
+	int64_t tick;
+
+	if (wheel_pending == 0)
+		return INT64_MAX;
+	if (!list_empty (&wheel_expired))
+		return ticks;
+
+	for (tick = wheel_tick; ; tick++) {
+		if (!list_empty (&wheel[0][tick & WHEEL_MASK]))
+			return tick;
+		if (((tick + 1) & WHEEL_MASK) == 0)
+			return tick + 1;
+	}
+}
+
+/* Called by the timer interrupt once the tick count reaches
+   NOW.  Queues wheel_work if any event may be due. */
+static void
+wheel_advance (int64_t now) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (wheel_pending == 0)
+		wheel_tick = now + 1;
+	else if (wheel_tick <= now || !list_empty (&wheel_expired))
+		work_queue (&wheel_work, WORK_HIGH);
+}
+
+/* Removes and returns the next event that is due by the current
+   tick, processing wheel ticks as needed, or returns a null
+   pointer if no event is due. */
+static struct timer_event *
+wheel_pop_expired (void) {
+	struct timer_event *ev;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (list_empty (&wheel_expired)) {
+		int idx = wheel_tick & WHEEL_MASK;
+		struct list *slot = &wheel[0][idx];
+		int level;
+
+		if (wheel_pending == 0) {
+			wheel_tick = ticks + 1;
+			return NULL;
+		}
+		if (wheel_tick > ticks)
+			return NULL;
+
+		/* Level 0 wrapped: pull the next slot of each coarser
+		   level that also wrapped down into the finer levels. */
+		if (idx == 0)
+			for (level = 1; level < WHEEL_LEVELS; level++) {
+				int cascade_idx = (wheel_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+				wheel_cascade (level, cascade_idx);
+				if (cascade_idx != 0)
+					break;
+			}
+
+		/* Detach the expired events before running any of them,
+		   so that a callback re-adding itself for a past
+		   deadline lands on the next tick instead of this one. */
+		if (!list_empty (slot))
+			list_splice (list_end (&wheel_expired), list_begin (slot),
+					list_end (slot));
+		wheel_tick++;
+	}
+
+	ev = list_entry (list_pop_front (&wheel_expired), struct timer_event, elem);
+	ev->pending = false;
+	wheel_pending--;
+	return ev;
+}
+
+/* Work function that fires every event due by the current tick,
+   each with interrupts off, letting interrupts in between. */
+static void
+wheel_run (void *aux UNUSED) {
+	struct timer_event *ev;
+
+	intr_disable ();
+	while ((ev = wheel_pop_expired ()) != NULL) {
+		ev->func (ev, ev->aux);
+		intr_enable ();
+		intr_disable ();
+	}
+	intr_enable ();
+}
+
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t start = rdtsc ();
+
+	bool ticked = false;
+
+	if (!oneshot) {
+		last_tick_tsc = start;
+		timer_tick ();
+		ticked = true;
+	} else {
+		/* A countdown ended, which may or may not also be the end
+		   of a tick. */
+		while ((int64_t) (start - last_tick_tsc)
+				>= (int64_t) (tsc_per_tick - tsc_per_tick / 32)) {
+			last_tick_tsc += tsc_per_tick;
+			timer_tick ();
+			ticked = true;
+		}
+	}
+	wheel_advance (ticks);
+	if (tsc_hz != 0) {
+		hrtimer_expire (start);
+
+		/* Go back to periodic ticks, in phase with this one, once
+		   no hrtimer needs an earlier interrupt. */
+		if (oneshot && ticked && clockevent->set_periodic != NULL
+				&& !hrtimer_due_before (last_tick_tsc + tsc_per_tick)) {
+			clockevent->set_periodic ();
+			last_tick_tsc = start;
+			oneshot = false;
+		} else
+			clockevent_reprogram (start);
+	}
+	interrupt_cycles += rdtsc () - start;
+}
+
+/* Counts one timer tick. */
+static void
+timer_tick (void) {
+	ticks++;
+	sched_trace (SCHED_EV_TICK, thread_tid (), THREAD_RUNNING, THREAD_RUNNING,
+			thread_get_priority ());
+	thread_tick ();
+}
+
+/* Sleep for approximately NUM/DENOM seconds, where DENOM
+   divides 1,000,000,000.  Sleeps shorter than HRTIMER_MIN_NS
+   spin; longer ones block on an hrtimer. */
 static void
 real_time_sleep (int64_t num, int32_t denom) {
-	/* Convert NUM/DENOM seconds into timer ticks, rounding down.
+	int64_t ns;
+	enum intr_level old_level;
+	struct hrtimer hr;
 
-	   (NUM / DENOM) s
-	   ---------------------- = NUM * TIMER_FREQ / DENOM ticks.
-	   1 s / TIMER_FREQ ticks
-	   */
-	int64_t ticks = num * TIMER_FREQ / denom;
+	/* Sleeps too long to count in nanoseconds last forever. */
+	if (num > INT64_MAX / (NSEC_PER_SEC / denom))
+		ns = INT64_MAX;
+	else
+		ns = num * (NSEC_PER_SEC / denom);
 
 	ASSERT (intr_get_level () == INTR_ON);
-	if (ticks > 0) {
-		/* We're waiting for at least one full timer tick.  Use
-		   timer_sleep() because it will yield the CPU to other
-		   processes. */
-		timer_sleep (ticks);
-	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		ASSERT (denom % 1000 == 0);
-		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+	ASSERT (tsc_hz != 0);
+	if (ns <= 0)
+		return;
+
+	if (ns < HRTIMER_MIN_NS) {
+		uint64_t end = rdtsc () + ns_to_tsc (ns);
+		while ((int64_t) (rdtsc () - end) < 0)
+			barrier ();
+		return;
 	}
+
+	hr.pending = false;
+	old_level = intr_disable ();
+	hrtimer_start (&hr, timer_clock_ns () + ns, hrtimer_wake, thread_current ());
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Hrtimer callback that wakes up thread T_, which is blocked in
+   real_time_sleep(). */
+static void
+hrtimer_wake (struct hrtimer *hr UNUSED, void *t_) {
+	struct thread *t = t_;
+
+	thread_unblock (t);
+	if (!thread_cfs && t->priority > thread_current ()->priority)
+		intr_yield_on_return ();
+}
+
+/* Converts NS nanoseconds to TSC cycles. */
+static uint64_t
+ns_to_tsc (uint64_t ns) {
+	return scale (ns, tsc_hz, NSEC_PER_SEC);
+}
+
+/* Converts CYCLES TSC cycles to nanoseconds. */
+static uint64_t
+tsc_to_ns (uint64_t cycles) {
+	return scale (cycles, NSEC_PER_SEC, tsc_hz);
+}
+
+/* Returns X * MUL / DIV, rounded down.  Dividing first keeps the
+   intermediate products in range as long as DIV * MUL fits in
+   64 bits. */
+static uint64_t
+scale (uint64_t x, uint64_t mul, uint64_t div) {
+	return x / div * mul + x % div * mul / div;
 }
@@ -0,0 +1,26 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Vectors for interrupts that the local APIC raises itself.
+   Those from LAPIC_TIMER_VEC up to, but not including,
+   LAPIC_SPURIOUS_VEC are external interrupts, acknowledged with
+   lapic_eoi() instead of at the PIC. */
+#define LAPIC_TIMER_VEC 0xf0
+#define LAPIC_SPURIOUS_VEC 0xff
+
+bool lapic_init (void);
+bool lapic_present (void);
+void lapic_eoi (void);
+
+bool lapic_timer_has_deadline (void);
+void lapic_timer_calibrate_start (void);
+uint32_t lapic_timer_calibrate_end (void);
+void lapic_timer_periodic (uint32_t count);
+void lapic_timer_oneshot (uint32_t count);
+void lapic_timer_deadline (uint64_t deadline);
+void lapic_timer_stop (void);
+
+#endif /* devices/lapic.h */
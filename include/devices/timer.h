@@ -1,23 +1,85 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
+#include <pqueue.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
-/* Number of timer interrupts per second. */
-#define TIMER_FREQ 100
+/* Number of timer interrupts per second, from 19 to 1000.
+   Controlled by kernel command-line option "-hz". */
+extern unsigned timer_freq;
+#define TIMER_FREQ timer_freq
+
+/* Devices that can drive the timer tick. */
+enum timer_source {
+	TIMER_PIT,                  /* 8254 Programmable Interval Timer. */
+	TIMER_LAPIC,                /* Local APIC timer. */
+	TIMER_DEADLINE,             /* Local APIC timer in TSC-deadline mode. */
+};
+
+/* Device to drive the timer tick, once the timer is calibrated.
+   Controlled by kernel command-line option "-timer". */
+extern enum timer_source timer_source;
+
+/* Stop the periodic tick while idle?
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
 
 void timer_init (void);
 void timer_calibrate (void);
+void timer_idle_enter (void);
+void timer_idle_exit (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+uint64_t timer_clock_ns (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+uint64_t timer_interrupt_cycles (void);
 void timer_print_stats (void);
 
+/* A one-shot timeout.  Once the tick count reaches DEADLINE,
+   work deferred by the timer interrupt calls FUNC with
+   interrupts off (see threads/softirq.h).  The event is embedded
+   in its owner, so adding one never allocates. */
+struct timer_event;
+typedef void timer_func (struct timer_event *, void *aux);
+
+struct timer_event {
+	struct list_elem elem;      /* Element in a timer wheel slot. */
+	int64_t deadline;           /* Tick at which FUNC runs. */
+	timer_func *func;           /* Callback, run in interrupt context. */
+	void *aux;                  /* Argument to FUNC. */
+	bool pending;               /* Added but not yet fired or cancelled? */
+};
+
+void timer_add (struct timer_event *, int64_t deadline,
+		timer_func *, void *aux);
+bool timer_cancel (struct timer_event *);
+
+/* A one-shot high-resolution timeout.  Once timer_clock_ns()
+   reaches the deadline, the timer interrupt calls FUNC with
+   interrupts off.  Like a timer_event, it is embedded in its
+   owner, and PENDING must be false before it is first started. */
+struct hrtimer;
+typedef void hrtimer_func (struct hrtimer *, void *aux);
+
+struct hrtimer {
+	struct pq_elem elem;        /* Element in the hrtimer heap. */
+	uint64_t expires;           /* TSC value at which FUNC runs. */
+	hrtimer_func *func;         /* Callback, run in interrupt context. */
+	void *aux;                  /* Argument to FUNC. */
+	bool pending;               /* Started but not yet fired or cancelled? */
+};
+
+void hrtimer_start (struct hrtimer *, uint64_t deadline_ns,
+		hrtimer_func *, void *aux);
+bool hrtimer_cancel (struct hrtimer *);
+
 #endif /* devices/timer.h */
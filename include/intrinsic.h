@@ -1,4 +1,5 @@
 #ifndef INSTRINSIC_H
+#define INSTRINSIC_H
 #include "threads/mmu.h"
 
 /* Store the physical address of the page directory into CR3
@@ -128,4 +129,26 @@ static __inline void write_msr(uint32_t ecx, uint64_t val) {
 			:: "c" (ecx), "d" (edx), "a" (eax) );
 }
 
+__attribute__((always_inline))
+static __inline uint64_t read_msr(uint32_t ecx) {
+	uint32_t edx, eax;
+	__asm __volatile("rdmsr" : "=d" (edx), "=a" (eax) : "c" (ecx));
+	return ((uint64_t) edx << 32) | eax;
+}
+
+__attribute__((always_inline))
+static __inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+		uint32_t *ecx, uint32_t *edx) {
+	__asm __volatile("cpuid"
+			: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+			: "a" (leaf), "c" (0));
+}
+
+__attribute__((always_inline))
+static __inline uint64_t rdtsc(void) {
+	uint32_t lo, hi;
+	__asm __volatile("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
 #endif /* intrinsic.h */
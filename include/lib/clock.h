@@ -0,0 +1,15 @@
+#ifndef __LIB_CLOCK_H
+#define __LIB_CLOCK_H
+
+#include <stdint.h>
+
+/* Clocks for clock_gettime(). */
+#define CLOCK_MONOTONIC 1       /* Time since boot. */
+
+/* A time or a duration. */
+struct timespec {
+	int64_t tv_sec;             /* Seconds. */
+	int64_t tv_nsec;            /* Nanoseconds, 0 to 999,999,999. */
+};
+
+#endif /* lib/clock.h */
@@ -0,0 +1,13 @@
+#ifndef __LIB_FUTEX_H
+#define __LIB_FUTEX_H
+
+/* Results of the futex_wait() system call. */
+#define FUTEX_WOKEN 0           /* Woken by futex_wake(). */
+#define FUTEX_FAULT (-1)        /* Address was bad or misaligned. */
+#define FUTEX_AGAIN (-2)        /* Word did not hold the expected value. */
+#define FUTEX_TIMEDOUT (-3)     /* Timeout expired first. */
+
+/* Timeout for futex_wait() that never expires. */
+#define FUTEX_FOREVER (-1)
+
+#endif /* lib/futex.h */
@@ -0,0 +1,71 @@
+#ifndef __LIB_KERNEL_PQUEUE_H
+#define __LIB_KERNEL_PQUEUE_H
+
+/* Priority queue.
+ *
+ * A pairing heap whose top is its greatest element.  Pushing an
+ * element and reading the top take O(1) time; popping the top,
+ * removing an arbitrary element, and repositioning an element
+ * whose key changed take O(lg n) amortized time.
+ *
+ * Like the linked list and hash table implementations, the queue
+ * does not use dynamic allocation.  Each structure that can be
+ * in a queue must embed a struct pq_elem member, and the
+ * pq_entry macro converts a struct pq_elem back to the structure
+ * that contains it.  See lib/kernel/list.h for a detailed
+ * explanation of the technique.
+ *
+ * Elements that compare equal leave the queue in the order they
+ * were pushed, so a queue of waiting threads ordered by priority
+ * is FIFO within each priority. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Priority queue element. */
+struct pq_elem {
+	struct pq_elem *child;      /* First child. */
+	struct pq_elem *next;       /* Next sibling. */
+	struct pq_elem *prev;       /* Previous sibling, or parent if first. */
+	uint64_t seq;               /* Push order, to break ties. */
+};
+
+/* Converts pointer to queue element PQ_ELEM into a pointer to
+ * the structure that PQ_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the queue element. */
+#define pq_entry(PQ_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) (PQ_ELEM)              \
+		- offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two queue elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool pq_less_func (const struct pq_elem *a,
+		const struct pq_elem *b,
+		void *aux);
+
+/* Priority queue. */
+struct pqueue {
+	struct pq_elem *root;       /* Greatest element, or NULL if empty. */
+	size_t elem_cnt;            /* Number of elements. */
+	uint64_t next_seq;          /* Sequence number for the next push. */
+	pq_less_func *less;         /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void pq_init (struct pqueue *, pq_less_func *, void *aux);
+
+/* Insertion and removal. */
+void pq_push (struct pqueue *, struct pq_elem *);
+struct pq_elem *pq_pop (struct pqueue *);
+void pq_remove (struct pqueue *, struct pq_elem *);
+void pq_update (struct pqueue *, struct pq_elem *);
+
+/* Information. */
+struct pq_elem *pq_top (const struct pqueue *);
+size_t pq_size (const struct pqueue *);
+bool pq_empty (const struct pqueue *);
+
+#endif /* lib/kernel/pqueue.h */
@@ -36,6 +36,14 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Scheduling and timing extensions, numbered after the
+	   calls above so that their numbers stay stable. */
+	SYS_THREAD_STATS,           /* Obtain scheduling statistics. */
+	SYS_FUTEX_WAIT,             /* Sleep until a futex is woken. */
+	SYS_FUTEX_WAKE,             /* Wake threads sleeping on a futex. */
+	SYS_CLOCK_GETTIME,          /* Read a clock. */
+	SYS_NANOSLEEP,              /* Sleep for a given time. */
 };
 
 #endif /* lib/syscall-nr.h */
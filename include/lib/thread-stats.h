@@ -0,0 +1,26 @@
+#ifndef __LIB_THREAD_STATS_H
+#define __LIB_THREAD_STATS_H
+
+#include <stdint.h>
+
+/* Number of buckets in the ready-latency histogram. */
+#define THREAD_STATS_BUCKETS 32
+
+/* Per-thread scheduling statistics, as returned by the
+   thread_stats() system call. */
+struct thread_stats {
+	int64_t kernel_ticks;         /* Timer ticks spent in kernel mode. */
+	int64_t user_ticks;           /* Timer ticks spent in user mode. */
+	int64_t voluntary_switches;   /* Gave up the CPU by blocking. */
+	int64_t involuntary_switches; /* Preempted or yielded while runnable. */
+	int64_t ready_waits;          /* Times dispatched from the ready queue. */
+	uint64_t ready_cycles;        /* Total TSC cycles spent ready. */
+
+	/* Histogram of ready-queue waits: bucket 0 counts waits under
+	   2 kilocycles, bucket I > 0 counts waits of 2**I to
+	   2**(I+1) - 1 kilocycles, and the last bucket counts all
+	   longer waits. */
+	uint32_t ready_hist[THREAD_STATS_BUCKETS];
+};
+
+#endif /* lib/thread-stats.h */
@@ -0,0 +1,30 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* User-level mutex.  Acquiring and releasing an uncontended
+   mutex takes a single atomic instruction and no system call;
+   threads that must wait sleep in futex_wait(). */
+struct mutex {
+	int state;          /* 0: unlocked, 1: locked, 2: locked, may have waiters. */
+};
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* User-level condition variable, used with a struct mutex. */
+struct condvar {
+	int seq;            /* Incremented by every signal. */
+};
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+bool condvar_timedwait (struct condvar *, struct mutex *, int64_t timeout_ms);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
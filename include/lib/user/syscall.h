@@ -4,6 +4,10 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <clock.h>
+#include <futex.h>
+#include <thread-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -37,6 +41,11 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int thread_stats (struct thread_stats *);
+int futex_wait (int *addr, int expected, int64_t timeout_ms);
+int futex_wake (int *addr, int wake_cnt);
+int clock_gettime (int clock, struct timespec *);
+int nanosleep (const struct timespec *);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
@@ -0,0 +1,13 @@
+#ifndef THREADS_FUTEX_H
+#define THREADS_FUTEX_H
+
+#include <futex.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+void futex_init (void);
+bool futex_valid (const int *addr);
+int futex_wait (int *addr, int expected, int64_t timeout_ms);
+int futex_wake (int *addr, int wake_cnt);
+
+#endif /* threads/futex.h */
@@ -71,6 +71,8 @@ void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
+void intr_off_end (void);
+void intr_print_stats (void);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
@@ -0,0 +1,96 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdint.h>
+
+/* Lock contention statistics.
+
+   When the kernel is built with LOCKSTAT defined (`make
+   LOCKSTAT=1'), every struct lock counts how often it is
+   acquired and how often a thread had to wait for it, and
+   measures the time spent waiting for it and holding it in
+   time stamp counter cycles.  It also remembers the caller of
+   lock_acquire() that waited longest.  Locks that are given a
+   name with lockstat_register() are listed by
+   lockstat_print_stats() at shutdown.  Feed the call sites to
+   the `backtrace' utility to turn them into function names.
+
+   The hooks run inside lock_acquire() and lock_release() while
+   the lock is held, so no further locking is needed.  Without
+   LOCKSTAT, every hook below compiles to nothing. */
+
+/* Statistics for one lock. */
+struct lockstat {
+	char name[24];              /* Name, or empty if unregistered. */
+	struct lockstat *next;      /* Next registered lock. */
+	uint64_t acquire_cnt;       /* Number of acquisitions. */
+	uint64_t contend_cnt;       /* Acquisitions that had to wait. */
+	uint64_t wait_cycles;       /* Total cycles spent waiting. */
+	uint64_t max_wait_cycles;   /* Longest wait. */
+	void *max_wait_site;        /* Caller that waited longest. */
+	uint64_t hold_cycles;       /* Total cycles held. */
+	uint64_t max_hold_cycles;   /* Longest hold. */
+	uint64_t acquire_tsc;       /* When last acquired. */
+};
+
+#ifdef LOCKSTAT
+#include <debug.h>
+#include <intrinsic.h>
+#include <string.h>
+
+struct lock;
+
+/* Clears STAT, for lock_init(). */
+static inline void
+lockstat_init (struct lockstat *stat) {
+	memset (stat, 0, sizeof *stat);
+}
+
+/* Returns the time at which a lock_acquire() call starts. */
+#define lockstat_clock() rdtsc ()
+
+/* Records that STAT's lock was acquired after a wait that began
+   at START, by lock_acquire() called from SITE. */
+static inline void
+lockstat_contended (struct lockstat *stat, uint64_t start, void *site) {
+	uint64_t wait = rdtsc () - start;
+
+	stat->contend_cnt++;
+	stat->wait_cycles += wait;
+	if (wait > stat->max_wait_cycles) {
+		stat->max_wait_cycles = wait;
+		stat->max_wait_site = site;
+	}
+}
+
+/* Records that STAT's lock was acquired. */
+static inline void
+lockstat_acquired (struct lockstat *stat) {
+	stat->acquire_cnt++;
+	stat->acquire_tsc = rdtsc ();
+}
+
+/* Records that STAT's lock was released. */
+static inline void
+lockstat_released (struct lockstat *stat) {
+	uint64_t hold = rdtsc () - stat->acquire_tsc;
+
+	stat->hold_cycles += hold;
+	if (hold > stat->max_hold_cycles)
+		stat->max_hold_cycles = hold;
+}
+
+void lockstat_register (struct lock *, const char *format, ...)
+	PRINTF_FORMAT (2, 3);
+void lockstat_print_stats (void);
+#else
+#define lockstat_init(STAT) ((void) 0)
+#define lockstat_clock() ((uint64_t) 0)
+#define lockstat_contended(STAT, START, SITE) ((void) (START))
+#define lockstat_acquired(STAT) ((void) 0)
+#define lockstat_released(STAT) ((void) 0)
+#define lockstat_register(LOCK, ...) ((void) 0)
+#define lockstat_print_stats() ((void) 0)
+#endif
+
+#endif /* threads/lockstat.h */
@@ -4,10 +4,22 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of malloc() size classes that have per-thread
+   magazines of free blocks. */
+#define MALLOC_MAG_CNT 7
+
+/* A thread's stack of free blocks of one size class. */
+struct malloc_magazine {
+	void *head;                 /* Most recently freed block. */
+	size_t cnt;                 /* Number of blocks. */
+};
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_drain (void);
+void malloc_print_stats (void);
 
 #endif /* threads/malloc.h */
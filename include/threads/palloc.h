@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -11,6 +12,10 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* Number of buddy block orders.  Free blocks hold 2**K pages
+   for K from 0 up to PALLOC_ORDER_CNT - 1, or 1 GB. */
+#define PALLOC_ORDER_CNT 19
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
@@ -19,5 +24,11 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_extend (void *, size_t page_cnt, size_t new_cnt);
+void palloc_get_free_blocks (enum palloc_flags,
+		size_t free_blocks[PALLOC_ORDER_CNT]);
+bool palloc_zero_refill (void);
+void palloc_zero_stats (enum palloc_flags, long long *hits, long long *misses);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
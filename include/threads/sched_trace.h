@@ -0,0 +1,70 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdint.h>
+
+/* Scheduler event tracing.
+
+   When the kernel is built with SCHED_TRACE defined (`make
+   SCHED_TRACE=1'), the scheduler records compact events into a
+   fixed-size ring buffer that overwrites its oldest entries.
+   Recording an event is an atomic increment plus a handful of
+   stores, with no lock, so it is safe from any context,
+   including interrupt handlers.  sched_trace_dump() prints the
+   buffer to the console; utils/sched-trace converts that output
+   into a Chrome trace.
+
+   Without SCHED_TRACE, every hook below compiles to nothing. */
+
+/* Kinds of scheduler events. */
+enum sched_event {
+	SCHED_EV_SWITCH,            /* TID left the CPU, or got it. */
+	SCHED_EV_BLOCK,             /* TID blocked itself. */
+	SCHED_EV_UNBLOCK,           /* TID was made ready. */
+	SCHED_EV_SLEEP,             /* TID went to sleep on the timer. */
+	SCHED_EV_DONATE,            /* TID was donated PRIORITY. */
+	SCHED_EV_TICK,              /* Timer tick while TID ran. */
+};
+
+/* One recorded event.  16 bytes. */
+struct sched_trace_rec {
+	uint64_t tsc;               /* Time stamp counter. */
+	int32_t tid;                /* Thread concerned. */
+	uint8_t event;              /* enum sched_event. */
+	uint8_t old_state;          /* enum thread_status before. */
+	uint8_t new_state;          /* enum thread_status after. */
+	uint8_t priority;           /* Priority at the time. */
+};
+
+#ifdef SCHED_TRACE
+#include <intrinsic.h>
+
+/* Number of records kept.  Must be a power of 2. */
+#define SCHED_TRACE_SIZE 4096
+
+extern struct sched_trace_rec sched_trace_buf[SCHED_TRACE_SIZE];
+extern uint64_t sched_trace_head;
+
+/* Records EVENT for thread TID, which moved from OLD_STATE to
+   NEW_STATE, with priority PRIORITY. */
+static inline void
+sched_trace (enum sched_event event, int tid, int old_state, int new_state,
+		int priority) {
+	uint64_t idx = __atomic_fetch_add (&sched_trace_head, 1, __ATOMIC_RELAXED);
+	struct sched_trace_rec *r = &sched_trace_buf[idx & (SCHED_TRACE_SIZE - 1)];
+
+	r->tsc = rdtsc ();
+	r->tid = tid;
+	r->event = event;
+	r->old_state = old_state;
+	r->new_state = new_state;
+	r->priority = priority;
+}
+
+void sched_trace_dump (void);
+#else
+#define sched_trace(EVENT, TID, OLD_STATE, NEW_STATE, PRIORITY) ((void) 0)
+#define sched_trace_dump() ((void) 0)
+#endif
+
+#endif /* threads/sched_trace.h */
@@ -0,0 +1,29 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object caches.
+
+   A kmem_cache hands out objects of one fixed size, carved from
+   page-sized slabs, with no rounding up to a power of 2 and a
+   lock of its own instead of one shared with every malloc()
+   block of the same size class.  An optional constructor runs
+   once per object, when its slab is created, not on every
+   allocation: an object must be freed back in its constructed
+   state, and comes back out in it. */
+
+struct kmem_cache;
+
+/* Constructor for the objects of a cache. */
+typedef void kmem_ctor_func (void *obj);
+
+void kmem_cache_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		size_t align, kmem_ctor_func *);
+void kmem_cache_destroy (struct kmem_cache *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,53 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Deferred interrupt work.
+
+   An external interrupt handler runs with interrupts off, so
+   anything slow that it does delays every other interrupt.  It
+   can instead queue a work item, whose function runs once the
+   outermost interrupt handler is done and has acknowledged the
+   PIC, still on the interrupted thread's stack but with
+   interrupts on.  Interrupts that arrive meanwhile are handled
+   at once and may queue more work, which runs before the
+   interrupt returns.
+
+   Work functions run in interrupt context: intr_context() is
+   true, so they may not sleep, and intr_yield_on_return()
+   works as it does in a handler.  Unlike a handler, they may
+   turn interrupts on and off, and must turn them off around
+   anything that an interrupt handler also touches.  Higher
+   priority work always runs first. */
+
+/* Work priorities, highest first. */
+enum work_priority {
+	WORK_HIGH,                  /* Timer events. */
+	WORK_LOW,                   /* Bookkeeping. */
+	WORK_PRI_CNT
+};
+
+typedef void work_func (void *aux);
+
+/* A deferred work item.  The item is embedded in its owner, so
+   queueing one never allocates. */
+struct work {
+	struct list_elem elem;      /* Element in a work queue. */
+	work_func *func;            /* Function to run. */
+	void *aux;                  /* Argument to FUNC. */
+	bool queued;                /* Queued but not yet started? */
+};
+
+void softirq_init (void);
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *, enum work_priority);
+
+bool softirq_pending (void);
+void softirq_run (void);
+uint64_t softirq_cycles (void);
+void softirq_print_stats (void);
+
+#endif /* threads/softirq.h */
@@ -0,0 +1,31 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+/* switch_threads()'s stack frame: the callee-saved registers,
+   pushed in order from RBX down to R15, below the return
+   address. */
+struct switch_threads_frame {
+	uint64_t r15;
+	uint64_t r14;
+	uint64_t r13;
+	uint64_t r12;
+	uint64_t rbp;
+	uint64_t rbx;
+	void (*rip) (void);         /* Return address. */
+};
+
+/* Switches from the running thread to the thread whose saved
+   stack pointer is NEXT_STACK, storing the running thread's
+   stack pointer into *CUR_STACK.  Returns when some later call
+   switches back. */
+void switch_threads (uint8_t **cur_stack, uint8_t *next_stack);
+
+/* First code a new thread runs: jumps to the function in RBX,
+   passing R12 and R13 as its arguments. */
+void switch_entry (void);
+#endif
+
+#endif /* threads/switch.h */
@@ -2,13 +2,16 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pqueue.h>
 #include <stdbool.h>
+#include "threads/lockstat.h"
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
-	int * priority;				/* priority of the semaphore */
+	struct pqueue waiters;      /* Threads waiting, highest priority on top. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -16,14 +19,18 @@ void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
+void sema_requeue (struct thread *);
 
 /* Lock. */
 struct lock {
-	struct list_elem elem;
-	struct thread *holder;      /* Thread holding lock (for debugging). */
-	struct semaphore semaphore; /* Binary semaphore controlling access. */
-	int priority;               /* The current priority of the lock     */    
-	int holder_priority;    
+	struct pq_elem elem;        /* Element in holder's held_locks. */
+	struct thread *holder;      /* Thread holding lock, claimed with an
+	                               atomic compare-and-swap. */
+	struct semaphore semaphore; /* Where waiters sleep. */
+	struct pqueue waiters;      /* Threads waiting, highest priority on top. */
+#ifdef LOCKSTAT
+	struct lockstat stat;       /* Contention statistics. */
+#endif
 };
 
 void lock_init (struct lock *);
@@ -31,10 +38,13 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
-void lock_update_priority(struct lock * lock);
+int lock_priority (const struct lock *);
+bool lock_priority_less (const struct pq_elem *, const struct pq_elem *,
+		void *aux);
+
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct pqueue waiters;      /* Waiters, highest priority on top. */
 };
 
 void cond_init (struct condition *);
@@ -42,6 +52,48 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.  Any number of readers may hold it at
+ * once, or a single writer.  A writer that is waiting keeps new
+ * readers out, and threads that wait donate their priority to
+ * the writer. */
+struct rwlock {
+	struct lock writer;         /* Held by the writer, or a writer
+	                               waiting for readers to leave. */
+	unsigned readers;           /* Number of readers holding it. */
+	bool draining;              /* Writer waiting on `drained'? */
+	struct semaphore drained;   /* Upped when the last reader leaves. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+void rwlock_self_test (void);
+
+/* Sequence lock, for small records that are read much more
+ * often than they are written, such as counters updated by the
+ * timer interrupt.  Readers never block or disable interrupts:
+ * they read the record and then retry if a write happened
+ * meanwhile.  Writers must run with interrupts off.
+ *
+ *    do {
+ *        seq = seqlock_read_begin (&sl);
+ *        ...copy the record...
+ *    } while (seqlock_read_retry (&sl, seq));
+ */
+struct seqlock {
+	unsigned seq;               /* Odd while a write is in progress. */
+};
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned seq);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+void seqlock_self_test (void);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -3,12 +3,20 @@
 
 #include <debug.h>
 #include <list.h>
+#include <pqueue.h>
+#include <rbtree.h>
 #include <stdint.h>
+#include <thread-stats.h>
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "devices/timer.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
 
+struct lock;
+struct semaphore;
+struct semaphore_elem;
 
 /* States in a thread's life cycle. */
 enum thread_status {
@@ -18,12 +26,6 @@ enum thread_status {
 	THREAD_DYING        /* About to be destroyed. */
 };
 
-/* Which field to update when calling mlfqs_update_threads */
-enum thread_fields {
-	PRIORITY,
-	RECENT_CPU
-};
-
 /* Thread identifier type.
    You can redefine this to whatever type you like. */
 typedef int tid_t;
@@ -101,16 +103,28 @@ struct thread {
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
-	int64_t wakeup_tick;
-	bool in_sleep;
-	void * wait_on_lock;
-	int nice;
-	int recent_cpu;
+	struct timer_event sleep_timer;     /* Wakeup for thread_sleep(). */
+	int base_priority;                  /* Priority before donations. */
+	struct lock *wait_on_lock;          /* Lock being waited for, if any. */
+	struct pq_elem donor_elem;          /* Element in the lock's waiters. */
+	struct pqueue held_locks;           /* Locks held, by donated priority. */
+	struct semaphore *wait_sema;        /* Semaphore being waited for, if any. */
+	struct pq_elem wait_elem;           /* Element in wait_sema's waiters. */
+	struct semaphore_elem *cond_waiter; /* Condition wait in progress, if any. */
+	int nice;                           /* MLFQS niceness. */
+	int recent_cpu;                     /* MLFQS recent_cpu, fixed-point. */
+	int64_t recent_cpu_epoch;           /* Second recent_cpu is current as of. */
+	struct list_elem mlfqs_elem;        /* Element in mlfqs_parked[] if blocked. */
+	struct rb_node cfs_node;            /* Element in the CFS ready tree. */
+	uint64_t vruntime;                  /* CFS weighted run time. */
+	struct thread_stats stats;          /* Scheduling statistics. */
+	uint64_t ready_since;               /* TSC when last made ready. */
+
+	/* Owned by threads/malloc.c. */
+	struct malloc_magazine mags[MALLOC_MAG_CNT]; /* Free block caches. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
-	struct list_elem all_elem;
-	struct list donation_list;
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -123,6 +137,7 @@ struct thread {
 
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
+	uint8_t *stack;                     /* Saved kernel stack pointer. */
 	unsigned magic;                     /* Detects stack overflow. */
 };
 
@@ -131,18 +146,28 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler, which ignores
+   priorities and shares the CPU according to nice values.
+   Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+
+/* If true, print each thread's statistics when it exits.
+   Controlled by kernel command-line option "-thread-stats". */
+extern bool thread_exit_stats;
+
 void thread_init (void);
 void thread_start (void);
 void thread_tick (void);
-void thread_sleep(int64_t ticks);
+void thread_sleep (int64_t wakeup_tick);
 void thread_print_stats (void);
+void thread_get_stats (struct thread_stats *);
 
 typedef void thread_func (void *aux);
-struct list_elem * in_sleep_thread_remove(struct list_elem * elem);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_wake (struct thread *);
 void thread_run(struct thread * t);
 
 struct thread *thread_current (void);
@@ -151,22 +176,18 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
-void thread_wakeup(int64_t curr_tick);
+bool thread_yield_to (tid_t);
 int thread_get_priority (void);
 void thread_set_priority (int);
-bool thread_order_ready_list(const struct list_elem * a,const struct list_elem * b,void * aux UNUSED);
+bool thread_priority_less (const struct pq_elem *, const struct pq_elem *,
+		void *aux);
+bool thread_refresh_priority (struct thread *);
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
 void do_iret (struct intr_frame *tf);
-void mlfqs_update_priority(struct thread * t);
-void mlfqs_update_recent_cpu(struct thread * t);
-void mlfqs_increment_recent_cpu(void);
-void mlfqs_update_load_avg(void);
-void mlfqs_update_threads(enum thread_fields field);
-void mlfqs_update(int64_t ticks);
 
 
 #endif /* threads/thread.h */
@@ -0,0 +1,197 @@
+/* Priority queue.
+
+   A pairing heap, as described in Fredman, Sedgewick, Sleator
+   and Tarjan, "The Pairing Heap: A New Form of Self-Adjusting
+   Heap", Algorithmica 1, 1986.  Every routine here is iterative,
+   because kernel stacks are too small for recursion over long
+   sibling lists.  See pqueue.h for basic information. */
+
+#include "pqueue.h"
+#include "../debug.h"
+
+static bool higher (const struct pqueue *, const struct pq_elem *,
+		const struct pq_elem *);
+static struct pq_elem *meld (const struct pqueue *, struct pq_elem *,
+		struct pq_elem *);
+static struct pq_elem *merge_pairs (const struct pqueue *,
+		struct pq_elem *);
+static void detach (struct pq_elem *);
+
+/* Initializes PQ as an empty queue that orders its elements
+   using LESS, given auxiliary data AUX. */
+void
+pq_init (struct pqueue *pq, pq_less_func *less, void *aux) {
+	ASSERT (pq != NULL);
+	ASSERT (less != NULL);
+
+	pq->root = NULL;
+	pq->elem_cnt = 0;
+	pq->next_seq = 0;
+	pq->less = less;
+	pq->aux = aux;
+}
+
+/* Inserts E into PQ, behind any elements that compare equal. */
+void
+pq_push (struct pqueue *pq, struct pq_elem *e) {
+	ASSERT (pq != NULL);
+	ASSERT (e != NULL);
+
+	e->child = e->next = e->prev = NULL;
+	e->seq = pq->next_seq++;
+	pq->root = meld (pq, pq->root, e);
+	pq->elem_cnt++;
+}
+
+/* Removes and returns the greatest element of PQ, which must not
+   be empty. */
+struct pq_elem *
+pq_pop (struct pqueue *pq) {
+	struct pq_elem *top = pq_top (pq);
+
+	ASSERT (top != NULL);
+	pq_remove (pq, top);
+	return top;
+}
+
+/* Removes E, which must be in PQ, from PQ. */
+void
+pq_remove (struct pqueue *pq, struct pq_elem *e) {
+	struct pq_elem *children;
+
+	ASSERT (pq != NULL);
+	ASSERT (e != NULL);
+	ASSERT (pq->elem_cnt > 0);
+
+	children = merge_pairs (pq, e->child);
+	if (e == pq->root)
+		pq->root = children;
+	else {
+		detach (e);
+		pq->root = meld (pq, pq->root, children);
+	}
+	e->child = NULL;
+	pq->elem_cnt--;
+}
+
+/* Moves E, which must be in PQ, to its proper place after its
+   key has changed in either direction.  E keeps its place among
+   elements that compare equal to it. */
+void
+pq_update (struct pqueue *pq, struct pq_elem *e) {
+	uint64_t seq = e->seq;
+
+	pq_remove (pq, e);
+	e->next = e->prev = NULL;
+	e->seq = seq;
+	pq->root = meld (pq, pq->root, e);
+	pq->elem_cnt++;
+}
+
+/* Returns the greatest element of PQ, or a null pointer if PQ
+   is empty. */
+struct pq_elem *
+pq_top (const struct pqueue *pq) {
+	ASSERT (pq != NULL);
+	return pq->root;
+}
+
+/* Returns the number of elements in PQ. */
+size_t
+pq_size (const struct pqueue *pq) {
+	ASSERT (pq != NULL);
+	return pq->elem_cnt;
+}
+
+/* Returns true if PQ is empty, false otherwise. */
+bool
+pq_empty (const struct pqueue *pq) {
+	ASSERT (pq != NULL);
+	return pq->root == NULL;
+}
+
+/* Returns true if A belongs above B in PQ: A is greater, or they
+   compare equal and A was pushed first. */
+static bool
+higher (const struct pqueue *pq, const struct pq_elem *a,
+		const struct pq_elem *b) {
+	if (pq->less (b, a, pq->aux))
+		return true;
+	if (pq->less (a, b, pq->aux))
+		return false;
+	return a->seq < b->seq;
+}
+
+/* Melds the heaps rooted at A and B, either of which may be
+   null, and returns the root of the result. */
+static struct pq_elem *
+meld (const struct pqueue *pq, struct pq_elem *a, struct pq_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (higher (pq, b, a)) {
+		struct pq_elem *tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* Make B the first child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	a->next = a->prev = NULL;
+	return a;
+}
+
+/* Combines the sibling list starting at FIRST into a single
+   heap and returns its root, using the standard two passes:
+   meld adjacent pairs from left to right, then meld the results
+   from right to left. */
+static struct pq_elem *
+merge_pairs (const struct pqueue *pq, struct pq_elem *first) {
+	struct pq_elem *pairs = NULL;
+	struct pq_elem *root = NULL;
+
+	/* First pass.  The melded pairs are chained through `next'
+	   in reverse order, so the second pass can walk them from
+	   right to left. */
+	while (first != NULL) {
+		struct pq_elem *a = first;
+		struct pq_elem *b = a->next;
+		struct pq_elem *m;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL)
+			b->next = b->prev = NULL;
+		m = meld (pq, a, b);
+		m->next = pairs;
+		pairs = m;
+	}
+
+	/* Second pass. */
+	while (pairs != NULL) {
+		struct pq_elem *m = pairs;
+
+		pairs = m->next;
+		m->next = NULL;
+		root = meld (pq, root, m);
+	}
+	return root;
+}
+
+/* Unlinks non-root element E, along with its subtree, from its
+   parent and siblings. */
+static void
+detach (struct pq_elem *e) {
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	e->next = e->prev = NULL;
+}
@@ -0,0 +1,307 @@
+/* Red-black tree.
+
+   The algorithms follow [CLRS] chapter 13, with NULL in place of
+   the sentinel leaf.  See rbtree.h for basic information. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void replace_child (struct rb_tree *, struct rb_node *old,
+		struct rb_node *new);
+static void rotate_left (struct rb_tree *, struct rb_node *);
+static void rotate_right (struct rb_tree *, struct rb_node *);
+static void insert_fixup (struct rb_tree *, struct rb_node *);
+static void remove_fixup (struct rb_tree *, struct rb_node *,
+		struct rb_node *parent);
+
+/* Returns true if node N exists and is red. */
+static inline bool
+is_red (const struct rb_node *n) {
+	return n != NULL && n->red;
+}
+
+/* Initializes T as an empty tree that orders its nodes using
+   LESS, given auxiliary data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (less != NULL);
+
+	t->root = NULL;
+	t->min = NULL;
+	t->node_cnt = 0;
+	t->less = less;
+	t->aux = aux;
+}
+
+/* Inserts N into T.  N is placed after any nodes that compare
+   equal to it. */
+void
+rb_insert (struct rb_tree *t, struct rb_node *n) {
+	struct rb_node **link = &t->root;
+	struct rb_node *parent = NULL;
+	bool leftmost = true;
+
+	ASSERT (t != NULL);
+	ASSERT (n != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		if (t->less (n, parent, t->aux))
+			link = &parent->left;
+		else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+
+	n->parent = parent;
+	n->left = n->right = NULL;
+	n->red = true;
+	*link = n;
+	if (leftmost)
+		t->min = n;
+	t->node_cnt++;
+
+	insert_fixup (t, n);
+}
+
+/* Removes N, which must be in T, from T. */
+void
+rb_remove (struct rb_tree *t, struct rb_node *n) {
+	struct rb_node *child, *parent;
+	bool removed_red;
+
+	ASSERT (t != NULL);
+	ASSERT (n != NULL);
+	ASSERT (t->node_cnt > 0);
+
+	if (t->min == n)
+		t->min = rb_next (n);
+
+	if (n->left == NULL || n->right == NULL) {
+		/* N has at most one child, which takes its place. */
+		child = n->left != NULL ? n->left : n->right;
+		parent = n->parent;
+		removed_red = n->red;
+		replace_child (t, n, child);
+		if (child != NULL)
+			child->parent = parent;
+	} else {
+		/* N's successor Y, which has no left child, takes N's
+		   place, and Y's right child takes Y's place. */
+		struct rb_node *y = n->right;
+		while (y->left != NULL)
+			y = y->left;
+
+		child = y->right;
+		removed_red = y->red;
+		if (y->parent == n)
+			parent = y;
+		else {
+			parent = y->parent;
+			parent->left = child;
+			if (child != NULL)
+				child->parent = parent;
+			y->right = n->right;
+			y->right->parent = y;
+		}
+		replace_child (t, n, y);
+		y->parent = n->parent;
+		y->left = n->left;
+		y->left->parent = y;
+		y->red = n->red;
+	}
+	t->node_cnt--;
+
+	if (!removed_red)
+		remove_fixup (t, child, parent);
+}
+
+/* Returns the smallest node in T, or NULL if T is empty. */
+struct rb_node *
+rb_min (const struct rb_tree *t) {
+	ASSERT (t != NULL);
+	return t->min;
+}
+
+/* Returns the node that follows N in its tree, or NULL if N is
+   the largest. */
+struct rb_node *
+rb_next (const struct rb_node *n) {
+	ASSERT (n != NULL);
+
+	if (n->right != NULL) {
+		n = n->right;
+		while (n->left != NULL)
+			n = n->left;
+		return (struct rb_node *) n;
+	}
+	while (n->parent != NULL && n == n->parent->right)
+		n = n->parent;
+	return n->parent;
+}
+
+/* Returns the number of nodes in T. */
+size_t
+rb_size (const struct rb_tree *t) {
+	return t->node_cnt;
+}
+
+/* Returns true if T is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *t) {
+	return t->root == NULL;
+}
+
+/* Makes NEW take OLD's place as a child of OLD's parent, or as
+   the root of T.  Does not update NEW's parent pointer. */
+static void
+replace_child (struct rb_tree *t, struct rb_node *old, struct rb_node *new) {
+	struct rb_node *parent = old->parent;
+
+	if (parent == NULL)
+		t->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+/* Rotates the subtree rooted at X to the left, so that X's
+   right child takes its place. */
+static void
+rotate_left (struct rb_tree *t, struct rb_node *x) {
+	struct rb_node *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	replace_child (t, x, y);
+	y->parent = x->parent;
+	y->left = x;
+	x->parent = y;
+}
+
+/* Rotates the subtree rooted at X to the right, so that X's
+   left child takes its place. */
+static void
+rotate_right (struct rb_tree *t, struct rb_node *x) {
+	struct rb_node *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	replace_child (t, x, y);
+	y->parent = x->parent;
+	y->right = x;
+	x->parent = y;
+}
+
+/* Restores the red-black properties after red node N has been
+   inserted into T. */
+static void
+insert_fixup (struct rb_tree *t, struct rb_node *n) {
+	struct rb_node *p;
+
+	while (is_red (p = n->parent)) {
+		struct rb_node *g = p->parent;
+
+		if (p == g->left) {
+			struct rb_node *u = g->right;
+			if (is_red (u)) {
+				p->red = u->red = false;
+				g->red = true;
+				n = g;
+				continue;
+			}
+			if (n == p->right) {
+				rotate_left (t, p);
+				n = p;
+				p = n->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_right (t, g);
+		} else {
+			struct rb_node *u = g->left;
+			if (is_red (u)) {
+				p->red = u->red = false;
+				g->red = true;
+				n = g;
+				continue;
+			}
+			if (n == p->left) {
+				rotate_right (t, p);
+				n = p;
+				p = n->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_left (t, g);
+		}
+	}
+	t->root->red = false;
+}
+
+/* Restores the red-black properties after a black node was
+   removed from T.  X, which may be NULL, is the node that took
+   its place, and PARENT is X's parent. */
+static void
+remove_fixup (struct rb_tree *t, struct rb_node *x, struct rb_node *parent) {
+	while (x != t->root && !is_red (x)) {
+		if (x == parent->left) {
+			struct rb_node *w = parent->right;
+			if (w->red) {
+				w->red = false;
+				parent->red = true;
+				rotate_left (t, parent);
+				w = parent->right;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->right)) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right (t, w);
+					w = parent->right;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->right->red = false;
+				rotate_left (t, parent);
+				x = t->root;
+			}
+		} else {
+			struct rb_node *w = parent->left;
+			if (w->red) {
+				w->red = false;
+				parent->red = true;
+				rotate_right (t, parent);
+				w = parent->left;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->left)) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left (t, w);
+					w = parent->left;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				w->left->red = false;
+				rotate_right (t, parent);
+				x = t->root;
+			}
+		}
+	}
+	if (x != NULL)
+		x->red = false;
+}
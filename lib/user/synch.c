@@ -0,0 +1,100 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* The mutex follows "Mutex, Take 2" from Ulrich Drepper,
+   "Futexes Are Tricky".  STATE is 0 when unlocked, 1 when
+   locked, and 2 when locked and some thread may be sleeping in
+   futex_wait(), so that releasing an uncontended mutex needs no
+   system call. */
+
+/* Initializes MUTEX as unlocked. */
+void
+mutex_init (struct mutex *mutex) {
+	mutex->state = 0;
+}
+
+/* Acquires MUTEX, sleeping until it is released if necessary. */
+void
+mutex_lock (struct mutex *mutex) {
+	int c = 0;
+
+	if (__atomic_compare_exchange_n (&mutex->state, &c, 1, false,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	/* Contended.  Mark the mutex as having waiters, and sleep
+	   until we are the ones who find it unlocked. */
+	if (c != 2)
+		c = __atomic_exchange_n (&mutex->state, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex_wait (&mutex->state, 2, FUTEX_FOREVER);
+		c = __atomic_exchange_n (&mutex->state, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+/* Acquires MUTEX if it is unlocked.  Returns true if successful,
+   false if some thread holds it. */
+bool
+mutex_trylock (struct mutex *mutex) {
+	int c = 0;
+
+	return __atomic_compare_exchange_n (&mutex->state, &c, 1, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Releases MUTEX, which the calling thread must hold, and wakes
+   one thread waiting for it, if any. */
+void
+mutex_unlock (struct mutex *mutex) {
+	if (__atomic_fetch_sub (&mutex->state, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n (&mutex->state, 0, __ATOMIC_RELEASE);
+		futex_wake (&mutex->state, 1);
+	}
+}
+
+/* Initializes COND. */
+void
+condvar_init (struct condvar *cond) {
+	cond->seq = 0;
+}
+
+/* Atomically releases MUTEX and waits for COND to be signaled,
+   then reacquires MUTEX.  As with kernel condition variables,
+   the caller must recheck its condition afterward. */
+void
+condvar_wait (struct condvar *cond, struct mutex *mutex) {
+	condvar_timedwait (cond, mutex, FUTEX_FOREVER);
+}
+
+/* Like condvar_wait(), but gives up waiting after TIMEOUT_MS
+   milliseconds, or never if TIMEOUT_MS is negative.  Returns
+   false if the wait timed out, true otherwise.  MUTEX is
+   reacquired either way. */
+bool
+condvar_timedwait (struct condvar *cond, struct mutex *mutex,
+		int64_t timeout_ms) {
+	int seq = __atomic_load_n (&cond->seq, __ATOMIC_RELAXED);
+	int result;
+
+	/* If a signal comes between the unlock and the wait, SEQ no
+	   longer matches and futex_wait() returns at once. */
+	mutex_unlock (mutex);
+	result = futex_wait (&cond->seq, seq, timeout_ms);
+	mutex_lock (mutex);
+	return result != FUTEX_TIMEDOUT;
+}
+
+/* Wakes one thread waiting on COND, if any. */
+void
+condvar_signal (struct condvar *cond) {
+	__atomic_fetch_add (&cond->seq, 1, __ATOMIC_RELEASE);
+	futex_wake (&cond->seq, 1);
+}
+
+/* Wakes all threads waiting on COND. */
+void
+condvar_broadcast (struct condvar *cond) {
+	__atomic_fetch_add (&cond->seq, 1, __ATOMIC_RELEASE);
+	futex_wake (&cond->seq, INT_MAX);
+}
@@ -145,6 +145,31 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+int
+thread_stats (struct thread_stats *stats) {
+	return syscall1 (SYS_THREAD_STATS, stats);
+}
+
+int
+futex_wait (int *addr, int expected, int64_t timeout_ms) {
+	return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout_ms);
+}
+
+int
+futex_wake (int *addr, int wake_cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, wake_cnt);
+}
+
+int
+clock_gettime (int clock, struct timespec *ts) {
+	return syscall2 (SYS_CLOCK_GETTIME, clock, ts);
+}
+
+int
+nanosleep (const struct timespec *ts) {
+	return syscall1 (SYS_NANOSLEEP, ts);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
@@ -0,0 +1,73 @@
+/* Checks that the completely fair scheduler divides the CPU in
+   proportion to the weights of the threads' nice values.
+
+   Two threads, one with nice 0 (weight 1024) and one with nice 5
+   (weight 335), spin for 10 seconds.  They should receive about
+   75% and 25% of the 1000 ticks, respectively. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPIN_SECONDS 10
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+    int nice;
+  };
+
+static thread_func load_thread;
+
+void
+test_cfs_nice (void) 
+{
+  struct thread_info info[2];
+  int64_t start_time;
+  int total, expected;
+  int i;
+
+  ASSERT (thread_cfs);
+
+  start_time = timer_ticks ();
+  for (i = 0; i < 2; i++) 
+    {
+      info[i].start_time = start_time;
+      info[i].tick_count = 0;
+      info[i].nice = i * 5;
+      thread_create ("load", PRI_DEFAULT, load_thread, &info[i]);
+    }
+
+  msg ("Sleeping %d seconds to let threads run, please wait...",
+       SPIN_SECONDS + 2);
+  timer_sleep ((SPIN_SECONDS + 2) * TIMER_FREQ);
+
+  total = info[0].tick_count + info[1].tick_count;
+  expected = total * 1024 / (1024 + 335);
+  if (info[0].tick_count < expected - total / 10
+      || info[0].tick_count > expected + total / 10)
+    fail ("nice 0 thread received %d of %d ticks, expected about %d",
+          info[0].tick_count, total, expected);
+  pass ();
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t spin_time = (SPIN_SECONDS + 1) * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  thread_set_nice (ti->nice);
+  timer_sleep (TIMER_FREQ - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
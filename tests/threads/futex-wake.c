@@ -0,0 +1,84 @@
+/* Checks futex_wait() and futex_wake() from kernel threads.
+
+   The main thread first checks the cases that do not sleep or
+   sleep alone: a word that no longer holds the expected value,
+   a timeout, and a wake with no waiters.  Then it creates three
+   higher-priority threads that sleep on the same word, the last
+   with a long timeout, wakes two of them and then the rest, and
+   checks that they woke in the order they went to sleep, that
+   each saw FUTEX_WOKEN, and that a wake on another word wakes
+   nobody. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/futex.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 3
+
+static int word;
+static int other;
+
+static int wake_order[WAITER_CNT];
+static int wake_result[WAITER_CNT];
+static int wake_cnt;
+
+static thread_func waiter;
+
+void
+test_futex_wake (void) 
+{
+  int i;
+
+  word = 0;
+  if (futex_wait (&word, 1, FUTEX_FOREVER) != FUTEX_AGAIN)
+    fail ("futex_wait on a changed word did not return FUTEX_AGAIN");
+  if (futex_wait (&word, 0, 10) != FUTEX_TIMEDOUT)
+    fail ("futex_wait did not time out");
+  if (futex_wake (&word, 1) != 0)
+    fail ("futex_wake woke a thread that was not waiting");
+  msg ("Non-sleeping cases and timeout behave.");
+
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT + 1, waiter, (void *) (intptr_t) i);
+    }
+  if (wake_cnt != 0)
+    fail ("a waiter returned before being woken");
+  if (futex_wake (&other, WAITER_CNT) != 0)
+    fail ("futex_wake on another word woke a waiter");
+
+  if (futex_wake (&word, 2) != 2)
+    fail ("futex_wake did not wake 2 waiters");
+  if (wake_cnt != 2)
+    fail ("%d waiters ran after waking 2", wake_cnt);
+  if (futex_wake (&word, WAITER_CNT) != 1)
+    fail ("futex_wake did not wake the last waiter");
+  if (wake_cnt != WAITER_CNT)
+    fail ("%d waiters ran after waking all", wake_cnt);
+
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      if (wake_order[i] != i)
+        fail ("waiter %d woke in position %d", wake_order[i], i);
+      if (wake_result[i] != FUTEX_WOKEN)
+        fail ("waiter %d returned %d", i, wake_result[i]);
+    }
+  msg ("Waiters woke in the order they went to sleep.");
+}
+
+/* Sleeps on `word' and records when it woke and why. */
+static void
+waiter (void *id_) 
+{
+  int id = (intptr_t) id_;
+  int64_t timeout = id == WAITER_CNT - 1 ? 10000 : FUTEX_FOREVER;
+  int result = futex_wait (&word, 0, timeout);
+
+  wake_result[id] = result;
+  wake_order[wake_cnt++] = id;
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wake) begin
+(futex-wake) Non-sleeping cases and timeout behave.
+(futex-wake) Waiters woke in the order they went to sleep.
+(futex-wake) end
+EOF
+pass;
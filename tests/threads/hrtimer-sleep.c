@@ -0,0 +1,70 @@
+/* Checks sub-tick sleeps and high-resolution timers.
+
+   timer_clock_ns() must never go backward.  timer_usleep() and
+   timer_nsleep() must sleep at least as long as asked, both for
+   durations short enough to spin and for ones that block on an
+   hrtimer before the next tick.  Sleeps of zero or negative
+   length, and of lengths too long to count in nanoseconds, must
+   not misbehave: the former return at once and an hrtimer set
+   for the latter must not fire. */
+
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+
+static const int64_t sleep_ns[] = {5000, 50000, 300000, 2000000};
+#define SLEEP_CNT (sizeof sleep_ns / sizeof *sleep_ns)
+
+static hrtimer_func far_timer_func;
+static bool far_timer_fired;
+
+void
+test_hrtimer_sleep (void) 
+{
+  struct hrtimer far_timer;
+  uint64_t last, now;
+  size_t i;
+  int j;
+
+  last = timer_clock_ns ();
+  for (j = 0; j < 100000; j++) 
+    {
+      now = timer_clock_ns ();
+      if (now < last)
+        fail ("clock went back from %llu to %llu ns",
+              (unsigned long long) last, (unsigned long long) now);
+      last = now;
+    }
+  msg ("timer_clock_ns() never went backward.");
+
+  for (i = 0; i < SLEEP_CNT; i++) 
+    {
+      uint64_t start = timer_clock_ns ();
+      uint64_t elapsed;
+
+      timer_nsleep (sleep_ns[i]);
+      elapsed = timer_clock_ns () - start;
+      if (elapsed < (uint64_t) sleep_ns[i])
+        fail ("%lld ns sleep returned after %llu ns",
+              (long long) sleep_ns[i], (unsigned long long) elapsed);
+    }
+  timer_usleep (0);
+  timer_nsleep (-1);
+  msg ("Sleeps lasted at least as long as asked.");
+
+  far_timer.pending = false;
+  hrtimer_start (&far_timer, timer_clock_ns () + (uint64_t) INT64_MAX,
+                 far_timer_func, NULL);
+  timer_msleep (20);
+  if (!hrtimer_cancel (&far_timer) || far_timer_fired)
+    fail ("an hrtimer set far in the future fired");
+  msg ("An hrtimer set far in the future did not fire.");
+}
+
+/* Records that the far-future hrtimer fired. */
+static void
+far_timer_func (struct hrtimer *hr UNUSED, void *aux UNUSED) 
+{
+  far_timer_fired = true;
+}
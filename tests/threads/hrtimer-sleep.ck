@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(hrtimer-sleep) begin
+(hrtimer-sleep) timer_clock_ns() never went backward.
+(hrtimer-sleep) Sleeps lasted at least as long as asked.
+(hrtimer-sleep) An hrtimer set far in the future did not fire.
+(hrtimer-sleep) end
+EOF
+pass;
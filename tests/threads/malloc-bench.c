@@ -0,0 +1,76 @@
+/* Measures the speed of malloc() and free().
+
+   The main thread first allocates and frees one small block over
+   and over, which runs entirely within its magazine for that
+   size class, and then repeatedly allocates a batch of blocks of
+   assorted sizes and frees them all, which also moves blocks
+   between the magazines and the free lists.  It reports the
+   number of malloc()/free() pairs per second of each, as
+   measured by the timer, and checks that no two live blocks in
+   a batch overlap. */
+
+#include <inttypes.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "devices/timer.h"
+
+#define PAIR_CNT 1000000
+#define BATCH_SIZE 64
+#define BATCH_CNT (PAIR_CNT / BATCH_SIZE)
+
+static void report (const char *what, int pair_cnt, int64_t elapsed);
+
+void
+test_malloc_bench (void) 
+{
+  static unsigned char *blocks[BATCH_SIZE];
+  int64_t start_time;
+  int i, j;
+
+  msg ("Allocating and freeing one block %d times...", PAIR_CNT);
+  start_time = timer_ticks ();
+  for (i = 0; i < PAIR_CNT; i++) 
+    {
+      void *p = malloc (32);
+      if (p == NULL)
+        fail ("malloc failed");
+      free (p);
+    }
+  report ("single", PAIR_CNT, timer_elapsed (start_time));
+
+  msg ("Allocating and freeing %d batches of %d blocks...",
+       BATCH_CNT, BATCH_SIZE);
+  start_time = timer_ticks ();
+  for (i = 0; i < BATCH_CNT; i++) 
+    {
+      for (j = 0; j < BATCH_SIZE; j++) 
+        {
+          blocks[j] = malloc (16 << (j % 7));
+          if (blocks[j] == NULL)
+            fail ("malloc failed");
+          blocks[j][0] = j;
+        }
+      for (j = 0; j < BATCH_SIZE; j++) 
+        {
+          if (blocks[j][0] != j)
+            fail ("block %d was overwritten", j);
+          free (blocks[j]);
+        }
+    }
+  report ("batched", BATCH_CNT * BATCH_SIZE, timer_elapsed (start_time));
+  pass ();
+}
+
+/* Reports the rate of PAIR_CNT pairs that took ELAPSED ticks. */
+static void
+report (const char *what, int pair_cnt, int64_t elapsed) 
+{
+  if (elapsed > 0)
+    msg ("%"PRId64" %s pairs per second.",
+         pair_cnt * (int64_t) TIMER_FREQ / elapsed, what);
+  else
+    msg ("more than %"PRId64" %s pairs per second.",
+         pair_cnt * (int64_t) TIMER_FREQ, what);
+}
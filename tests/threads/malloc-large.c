@@ -0,0 +1,116 @@
+/* Checks malloc()'s multi-page size classes and in-place
+   realloc().
+
+   Allocates blocks a little over 2 kB, which the 3 kB size class
+   must fit more than one to a page, and checks that they do not
+   overlap.  Then grows and shrinks blocks with realloc() in ways
+   that do not need to move them: within a size class, and, for a
+   block too big for any size class, into the free pages that the
+   page allocator left after it and back.  The contents must
+   survive every step.
+
+   Nothing between the two counts of free pages may block, or the
+   idle thread could take pages for its stock of zeroed ones. */
+
+#include <stdint.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define SMALL_SIZE 2100
+#define SMALL_CNT 40
+
+static size_t free_pages (void);
+static unsigned char *resize (unsigned char *, size_t size, const char *what);
+static void check_bytes (const unsigned char *, size_t size, int value);
+
+void
+test_malloc_large (void) 
+{
+  static unsigned char *blocks[SMALL_CNT];
+  unsigned char *p;
+  size_t before, used;
+  size_t i;
+
+  before = free_pages ();
+  for (i = 0; i < SMALL_CNT; i++) 
+    {
+      blocks[i] = malloc (SMALL_SIZE);
+      if (blocks[i] == NULL)
+        fail ("malloc failed");
+      memset (blocks[i], i, SMALL_SIZE);
+    }
+  used = before - free_pages ();
+  for (i = 0; i < SMALL_CNT; i++) 
+    {
+      check_bytes (blocks[i], SMALL_SIZE, i);
+      free (blocks[i]);
+    }
+  if (used >= SMALL_CNT)
+    fail ("%d blocks of %d bytes took %zu pages",
+          SMALL_CNT, SMALL_SIZE, used);
+  msg ("%d blocks of %d bytes took fewer than %d pages.",
+       SMALL_CNT, SMALL_SIZE, SMALL_CNT);
+
+  p = malloc (2500);
+  memset (p, 0x11, 2500);
+  p = resize (p, 3000, "growing within a size class");
+  p = resize (p, 2200, "shrinking within a size class");
+  check_bytes (p, 2200, 0x11);
+  free (p);
+  msg ("realloc() within a size class did not move the block.");
+
+  /* 5 pages, out of a buddy block of 8. */
+  p = malloc (5 * PGSIZE - 100);
+  memset (p, 0x22, 5 * PGSIZE - 100);
+  p = resize (p, 7 * PGSIZE - 100, "growing a big block into free pages");
+  check_bytes (p, 5 * PGSIZE - 100, 0x22);
+  memset (p, 0x33, 7 * PGSIZE - 100);
+  p = resize (p, 4 * PGSIZE - 100, "shrinking a big block");
+  check_bytes (p, 4 * PGSIZE - 100, 0x33);
+  free (p);
+  msg ("realloc() grew and shrank a big block in place.");
+}
+
+/* Returns the number of free pages in the kernel pool. */
+static size_t
+free_pages (void) 
+{
+  size_t free_blocks[PALLOC_ORDER_CNT];
+  size_t cnt = 0;
+  int order;
+
+  palloc_get_free_blocks (0, free_blocks);
+  for (order = 0; order < PALLOC_ORDER_CNT; order++)
+    cnt += free_blocks[order] << order;
+  return cnt;
+}
+
+/* Resizes P to SIZE bytes with realloc() and returns it,
+   failing with a message that starts with WHAT if the block
+   moved. */
+static unsigned char *
+resize (unsigned char *p, size_t size, const char *what) 
+{
+  uintptr_t old = (uintptr_t) p;
+
+  p = realloc (p, size);
+  if ((uintptr_t) p != old)
+    fail ("%s moved the block", what);
+  return p;
+}
+
+/* Fails unless all SIZE bytes at P equal VALUE. */
+static void
+check_bytes (const unsigned char *p, size_t size, int value) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != (unsigned char) value)
+      fail ("byte %zu of block %p is %#x, not %#x",
+            i, p, p[i], (unsigned char) value);
+}
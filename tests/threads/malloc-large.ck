@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-large) begin
+(malloc-large) 40 blocks of 2100 bytes took fewer than 40 pages.
+(malloc-large) realloc() within a size class did not move the block.
+(malloc-large) realloc() grew and shrank a big block in place.
+(malloc-large) end
+EOF
+pass;
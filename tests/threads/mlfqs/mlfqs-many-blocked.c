@@ -0,0 +1,95 @@
+/* Checks that the cost of the timer interrupt under the MLFQS
+   does not grow with the number of blocked threads.
+
+   The main thread spins for a few seconds and measures the
+   average number of cycles spent in each timer interrupt,
+   including the deferred work that runs right after it, where
+   the periodic MLFQS pass over the ready threads happens.  Then
+   it creates many threads that block on a semaphore and repeats
+   the measurement.  Only the running thread and the ready
+   threads need any work on a tick, so the two averages should
+   be close; walking every thread would make the second one
+   several times larger. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/softirq.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BLOCKED_CNT 200
+#define MEASURE_SECONDS 3
+
+static thread_func blocked_thread;
+static uint64_t measure_tick_cost (void);
+static uint64_t tick_cycles (void);
+
+void
+test_mlfqs_many_blocked (void) 
+{
+  struct semaphore sema;
+  uint64_t base_cost, blocked_cost;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  msg ("measuring tick cost with no blocked threads...");
+  base_cost = measure_tick_cost ();
+
+  msg ("creating %d blocked threads...", BLOCKED_CNT);
+  sema_init (&sema, 0);
+  for (i = 0; i < BLOCKED_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "blocked %d", i);
+      thread_create (name, PRI_DEFAULT, blocked_thread, &sema);
+    }
+  timer_sleep (TIMER_FREQ);
+
+  msg ("measuring tick cost with %d blocked threads...", BLOCKED_CNT);
+  blocked_cost = measure_tick_cost ();
+
+  for (i = 0; i < BLOCKED_CNT; i++)
+    sema_up (&sema);
+  timer_sleep (TIMER_FREQ);
+
+  if (blocked_cost > 2 * base_cost)
+    fail ("tick cost grew from %llu to %llu cycles with %d blocked threads",
+          (unsigned long long) base_cost, (unsigned long long) blocked_cost,
+          BLOCKED_CNT);
+  pass ();
+}
+
+/* Spins for MEASURE_SECONDS and returns the average number of
+   cycles spent in each timer interrupt and its deferred work
+   meanwhile. */
+static uint64_t
+measure_tick_cost (void) 
+{
+  int64_t start_time = timer_ticks ();
+  uint64_t start_cycles = tick_cycles ();
+  int64_t elapsed;
+
+  while (timer_elapsed (start_time) < MEASURE_SECONDS * TIMER_FREQ)
+    continue;
+  elapsed = timer_elapsed (start_time);
+  return (tick_cycles () - start_cycles) / elapsed;
+}
+
+/* Returns the cycles spent so far in timer interrupts and the
+   work they deferred. */
+static uint64_t
+tick_cycles (void) 
+{
+  return timer_interrupt_cycles () + softirq_cycles ();
+}
+
+static void
+blocked_thread (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+
+  sema_down (sema);
+}
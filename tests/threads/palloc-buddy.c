@@ -0,0 +1,64 @@
+/* Checks that the buddy page allocator merges blocks again.
+
+   Allocates runs of pages of assorted sizes, which splits larger
+   free blocks, and frees them in a different order.  Each freed
+   block merges with its buddy whenever both are free, so once
+   everything is freed the free blocks of each size must be just
+   as they were before.  Also checks that PAL_ZERO still clears
+   every page of a run.
+
+   Nothing between the two counts may block, or the idle thread
+   could take pages for its stock of zeroed ones, and single
+   PAL_ZERO pages would come out of that stock. */
+
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+static const size_t sizes[] = {3, 1, 8, 5, 1, 2, 16, 7};
+#define RUN_CNT (sizeof sizes / sizeof *sizes)
+
+static bool same_free_blocks (const size_t *a, const size_t *b);
+
+void
+test_palloc_buddy (void) 
+{
+  size_t before[PALLOC_ORDER_CNT], after[PALLOC_ORDER_CNT];
+  uint8_t *runs[RUN_CNT];
+  size_t i, j;
+
+  palloc_get_free_blocks (0, before);
+  for (i = 0; i < RUN_CNT; i++) 
+    {
+      enum palloc_flags flags = sizes[i] > 1 ? PAL_ZERO : 0;
+
+      runs[i] = palloc_get_multiple (PAL_ASSERT | flags, sizes[i]);
+      for (j = 0; flags & PAL_ZERO && j < sizes[i] * PGSIZE; j++)
+        if (runs[i][j] != 0)
+          fail ("run %zu not zeroed at offset %zu", i, j);
+      memset (runs[i], 0x5a, sizes[i] * PGSIZE);
+    }
+  palloc_get_free_blocks (0, after);
+  if (same_free_blocks (before, after))
+    fail ("allocating did not change the free blocks");
+
+  /* Free the odd runs, then the even ones. */
+  for (i = 1; i < RUN_CNT; i += 2)
+    palloc_free_multiple (runs[i], sizes[i]);
+  for (i = 0; i < RUN_CNT; i += 2)
+    palloc_free_multiple (runs[i], sizes[i]);
+  palloc_get_free_blocks (0, after);
+  if (!same_free_blocks (before, after))
+    fail ("free blocks differ after freeing every run");
+  msg ("Allocated %zu runs of pages.", RUN_CNT);
+  msg ("Freed runs merged back into the original blocks.");
+}
+
+/* Returns true if free block counts A and B are equal. */
+static bool
+same_free_blocks (const size_t *a, const size_t *b) 
+{
+  return !memcmp (a, b, PALLOC_ORDER_CNT * sizeof *a);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Allocated 8 runs of pages.
+(palloc-buddy) Freed runs merged back into the original blocks.
+(palloc-buddy) end
+EOF
+pass;
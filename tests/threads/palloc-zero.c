@@ -0,0 +1,47 @@
+/* Checks the stock of pre-zeroed pages.
+
+   Sleeps so that the idle thread can top up the stock, then
+   allocates single PAL_ZERO pages, dirtying and freeing each so
+   that a page that was not really cleared would show.  The
+   first requests must be served from the stock, and every page
+   must come out zeroed, whether or not it came from the
+   stock. */
+
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 64
+
+void
+test_palloc_zero (void) 
+{
+  long long hits, misses, hits0, misses0;
+  uint8_t *pages[PAGE_CNT];
+  size_t i, j;
+
+  timer_sleep (2);
+  palloc_zero_stats (0, &hits0, &misses0);
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      pages[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      for (j = 0; j < PGSIZE; j++)
+        if (pages[i][j] != 0)
+          fail ("page %zu not zeroed at offset %zu", i, j);
+      memset (pages[i], 0xa5, PGSIZE);
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+  palloc_zero_stats (0, &hits, &misses);
+
+  msg ("All %d pages came out zeroed.", PAGE_CNT);
+  if (hits - hits0 == 0)
+    fail ("no page came from the stock of zeroed pages");
+  if ((hits - hits0) + (misses - misses0) != PAGE_CNT)
+    fail ("%lld hits and %lld misses for %d requests",
+          hits - hits0, misses - misses0, PAGE_CNT);
+  msg ("Some pages came from the stock of zeroed pages.");
+}
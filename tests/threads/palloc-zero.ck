@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) All 64 pages came out zeroed.
+(palloc-zero) Some pages came from the stock of zeroed pages.
+(palloc-zero) end
+EOF
+pass;
@@ -0,0 +1,97 @@
+/* The main thread acquires a lock, then creates WAITER_CNT
+   threads of rising priority that all block on it, so that the
+   lock has many donors at once.  Checks that the main thread
+   runs at the highest donated priority, reports how many cycles
+   it takes to recompute that priority with so many donors, and
+   then releases the lock and checks that the waiters acquire it
+   in order of decreasing priority. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <intrinsic.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 128
+#define REFRESH_CNT 1000
+
+struct donate_many
+  {
+    struct lock lock;
+    int order[WAITER_CNT];      /* Priorities, in acquisition order. */
+    int acquire_cnt;            /* Number of entries in ORDER. */
+  };
+
+static thread_func waiter_thread;
+
+void
+test_priority_donate_many (void)
+{
+  struct donate_many dm;
+  int max_priority = PRI_MIN;
+  uint64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+  lock_init (&dm.lock);
+  dm.acquire_cnt = 0;
+  lock_acquire (&dm.lock);
+
+  /* Create the waiters in nondecreasing priority order.  Each one
+     either preempts us right away or, if it ties with our donated
+     priority, gets to run when we yield, so all of them are
+     blocked on the lock before we go on. */
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      char name[16];
+      int priority = PRI_MIN + 1 + i * (PRI_MAX - PRI_MIN - 1) / WAITER_CNT;
+
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, priority, waiter_thread, &dm);
+      thread_yield ();
+      if (priority > max_priority)
+        max_priority = priority;
+    }
+
+  if (thread_get_priority () != max_priority)
+    fail ("main thread should have priority %d, but has %d.",
+          max_priority, thread_get_priority ());
+  msg ("Main thread has priority %d with %d donors.",
+       max_priority, WAITER_CNT);
+
+  /* Each call recomputes our priority from the held lock's
+     highest waiter. */
+  start = rdtsc ();
+  for (i = 0; i < REFRESH_CNT; i++)
+    thread_set_priority (PRI_MIN);
+  msg ("%"PRIu64" cycles per priority change.",
+       (rdtsc () - start) / REFRESH_CNT);
+
+  lock_release (&dm.lock);
+
+  /* All of the waiters outrank us, so they have all run by now. */
+  if (dm.acquire_cnt != WAITER_CNT)
+    fail ("only %d of %d waiters acquired the lock.",
+          dm.acquire_cnt, WAITER_CNT);
+  for (i = 1; i < WAITER_CNT; i++)
+    if (dm.order[i] > dm.order[i - 1])
+      fail ("waiter of priority %d acquired the lock after one of "
+            "priority %d.", dm.order[i], dm.order[i - 1]);
+  msg ("Waiters acquired the lock in priority order.");
+  pass ();
+}
+
+static void
+waiter_thread (void *dm_)
+{
+  struct donate_many *dm = dm_;
+
+  lock_acquire (&dm->lock);
+  dm->order[dm->acquire_cnt++] = thread_get_priority ();
+  lock_release (&dm->lock);
+}
@@ -0,0 +1,121 @@
+/* Checks that a thread whose priority rises through donation
+   while it waits on a semaphore or a condition variable is woken
+   ahead of waiters that now have lower priority than it.
+
+   Thread "low" holds a lock and waits, then "mid" waits behind
+   it.  Then "high" blocks on the lock that "low" holds, which
+   donates its priority to "low" and should move "low" to the
+   front of the wait queue.  This is done once for a semaphore
+   and once for a condition variable. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct wakeup
+  {
+    bool use_cond;              /* Wait on COND instead of SEMA? */
+    struct lock donated;        /* Held by "low", wanted by "high". */
+    struct semaphore sema;      /* Waited on if !USE_COND. */
+    struct lock monitor;        /* Protects COND. */
+    struct condition cond;      /* Waited on if USE_COND. */
+  };
+
+static void run (bool use_cond);
+static void wait_one (struct wakeup *);
+static void wake_one (struct wakeup *);
+static thread_func low_thread;
+static thread_func mid_thread;
+static thread_func high_thread;
+
+void
+test_priority_donate_wakeup (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  run (false);
+  run (true);
+}
+
+static void
+run (bool use_cond)
+{
+  struct wakeup w;
+
+  w.use_cond = use_cond;
+  lock_init (&w.donated);
+  sema_init (&w.sema, 0);
+  lock_init (&w.monitor);
+  cond_init (&w.cond);
+
+  msg ("Waiting on a %s.", use_cond ? "condition variable" : "semaphore");
+  thread_create ("low", PRI_DEFAULT + 1, low_thread, &w);
+  thread_create ("mid", PRI_DEFAULT + 3, mid_thread, &w);
+  thread_create ("high", PRI_DEFAULT + 5, high_thread, &w);
+
+  msg ("Waking one waiter.");
+  wake_one (&w);
+  msg ("Waking one waiter.");
+  wake_one (&w);
+}
+
+/* Waits on W's semaphore or condition variable. */
+static void
+wait_one (struct wakeup *w)
+{
+  if (w->use_cond)
+    {
+      lock_acquire (&w->monitor);
+      cond_wait (&w->cond, &w->monitor);
+      lock_release (&w->monitor);
+    }
+  else
+    sema_down (&w->sema);
+}
+
+/* Wakes one waiter on W's semaphore or condition variable. */
+static void
+wake_one (struct wakeup *w)
+{
+  if (w->use_cond)
+    {
+      lock_acquire (&w->monitor);
+      cond_signal (&w->cond, &w->monitor);
+      lock_release (&w->monitor);
+    }
+  else
+    sema_up (&w->sema);
+}
+
+static void
+low_thread (void *w_)
+{
+  struct wakeup *w = w_;
+
+  lock_acquire (&w->donated);
+  wait_one (w);
+  msg ("Thread %s woke up with priority %d.",
+       thread_name (), thread_get_priority ());
+  lock_release (&w->donated);
+}
+
+static void
+mid_thread (void *w_)
+{
+  wait_one (w_);
+  msg ("Thread %s woke up with priority %d.",
+       thread_name (), thread_get_priority ());
+}
+
+static void
+high_thread (void *w_)
+{
+  struct wakeup *w = w_;
+
+  lock_acquire (&w->donated);
+  msg ("Thread %s acquired the lock.", thread_name ());
+  lock_release (&w->donated);
+}
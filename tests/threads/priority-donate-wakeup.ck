@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-wakeup) begin
+(priority-donate-wakeup) Waiting on a semaphore.
+(priority-donate-wakeup) Waking one waiter.
+(priority-donate-wakeup) Thread low woke up with priority 36.
+(priority-donate-wakeup) Thread high acquired the lock.
+(priority-donate-wakeup) Waking one waiter.
+(priority-donate-wakeup) Thread mid woke up with priority 34.
+(priority-donate-wakeup) Waiting on a condition variable.
+(priority-donate-wakeup) Waking one waiter.
+(priority-donate-wakeup) Thread low woke up with priority 36.
+(priority-donate-wakeup) Thread high acquired the lock.
+(priority-donate-wakeup) Waking one waiter.
+(priority-donate-wakeup) Thread mid woke up with priority 34.
+(priority-donate-wakeup) end
+EOF
+pass;
@@ -0,0 +1,145 @@
+/* Measures how well readers share a readers-writer lock.
+
+   READER_CNT threads each take the lock ROUND_CNT times and
+   sleep for a tick while holding it, once with an ordinary lock
+   and once with a readers-writer lock held for reading.  The
+   ordinary lock lets one reader in at a time, so the readers
+   take about READER_CNT times as long as with the rwlock, which
+   lets them all sleep at once.  A writer also takes the rwlock
+   now and then, to check that it still gets in. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 8
+#define ROUND_CNT 10
+#define WRITE_CNT 3
+
+struct readers
+  {
+    bool use_rwlock;            /* Use RWLOCK instead of LOCK? */
+    struct lock lock;
+    struct rwlock rwlock;
+    int active;                 /* Readers holding the lock now. */
+    int max_active;             /* Most readers ever holding it. */
+    int writes;                 /* Writes completed. */
+    struct semaphore done;      /* Upped as each thread finishes. */
+  };
+
+static int64_t run (struct readers *, bool use_rwlock);
+static thread_func reader_thread;
+static thread_func writer_thread;
+
+void
+test_rwlock_readers (void)
+{
+  struct readers r;
+  int64_t lock_ticks, rwlock_ticks;
+
+  rwlock_self_test ();
+  seqlock_self_test ();
+
+  lock_ticks = run (&r, false);
+  msg ("lock: %"PRId64" ticks, at most %d reader(s) at once.",
+       lock_ticks, r.max_active);
+
+  rwlock_ticks = run (&r, true);
+  msg ("rwlock: %"PRId64" ticks, at most %d reader(s) at once.",
+       rwlock_ticks, r.max_active);
+
+  if (r.max_active < 2)
+    fail ("readers never shared the rwlock.");
+  if (r.writes != WRITE_CNT)
+    fail ("writer finished %d of %d writes.", r.writes, WRITE_CNT);
+  if (rwlock_ticks >= lock_ticks)
+    fail ("readers were no faster with the rwlock.");
+  pass ();
+}
+
+/* Runs the readers, and with USE_RWLOCK the writer too, and
+   returns the number of ticks they took. */
+static int64_t
+run (struct readers *r, bool use_rwlock)
+{
+  int64_t start;
+  int thread_cnt = READER_CNT;
+  int i;
+
+  r->use_rwlock = use_rwlock;
+  lock_init (&r->lock);
+  rwlock_init (&r->rwlock);
+  r->active = r->max_active = r->writes = 0;
+  sema_init (&r->done, 0);
+
+  start = timer_ticks ();
+  for (i = 0; i < READER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, reader_thread, r);
+    }
+  if (use_rwlock)
+    {
+      thread_create ("writer", PRI_DEFAULT, writer_thread, r);
+      thread_cnt++;
+    }
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&r->done);
+  return timer_elapsed (start);
+}
+
+static void
+reader_thread (void *r_)
+{
+  struct readers *r = r_;
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      if (r->use_rwlock)
+        rwlock_read_acquire (&r->rwlock);
+      else
+        lock_acquire (&r->lock);
+
+      old_level = intr_disable ();
+      if (++r->active > r->max_active)
+        r->max_active = r->active;
+      intr_set_level (old_level);
+      timer_sleep (1);
+      old_level = intr_disable ();
+      r->active--;
+      intr_set_level (old_level);
+
+      if (r->use_rwlock)
+        rwlock_read_release (&r->rwlock);
+      else
+        lock_release (&r->lock);
+    }
+  sema_up (&r->done);
+}
+
+static void
+writer_thread (void *r_)
+{
+  struct readers *r = r_;
+  int i;
+
+  for (i = 0; i < WRITE_CNT; i++)
+    {
+      timer_sleep (2);
+      rwlock_write_acquire (&r->rwlock);
+      if (r->active != 0)
+        fail ("writer got the rwlock while %d reader(s) held it.",
+              r->active);
+      r->writes++;
+      rwlock_write_release (&r->rwlock);
+    }
+  sema_up (&r->done);
+}
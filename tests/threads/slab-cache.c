@@ -0,0 +1,91 @@
+/* Checks the object-cache allocator.
+
+   Creates a cache of odd-sized, 64-byte aligned objects with a
+   constructor, and checks that the constructor runs once per
+   object as slabs are created and not again when objects are
+   reused, that every object is aligned and does not overlap
+   another, that the most recently freed object is the first to
+   come back, and that the cache can be destroyed once all of its
+   objects have been freed. */
+
+#include <stdint.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+
+#define OBJ_SIZE 100
+#define OBJ_ALIGN 64
+#define OBJ_CNT 200
+
+struct obj
+  {
+    int magic;
+    char data[OBJ_SIZE - sizeof (int)];
+  };
+
+#define OBJ_MAGIC 0x0b1ec7
+
+static size_t ctor_cnt;
+
+static void
+obj_ctor (void *obj_)
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
+
+void
+test_slab_cache (void) 
+{
+  static struct obj *objs[OBJ_CNT];
+  struct kmem_cache *cache;
+  struct obj *obj;
+  size_t ctors, i;
+
+  cache = kmem_cache_create ("slab-cache", sizeof (struct obj), OBJ_ALIGN,
+                             obj_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create failed");
+
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("allocation %zu failed", i);
+      if ((uintptr_t) objs[i] % OBJ_ALIGN != 0)
+        fail ("object %zu at %p is misaligned", i, objs[i]);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %zu was not constructed", i);
+      memset (objs[i]->data, i & 0xff, sizeof objs[i]->data);
+    }
+  if (ctor_cnt < OBJ_CNT)
+    fail ("%zu constructor calls for %d objects", ctor_cnt, OBJ_CNT);
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      size_t j;
+
+      for (j = 0; j < sizeof objs[i]->data; j++)
+        if (objs[i]->data[j] != (char) (i & 0xff))
+          fail ("object %zu was overwritten", i);
+    }
+  msg ("Allocated %d aligned, constructed objects.", OBJ_CNT);
+
+  ctors = ctor_cnt;
+  obj = objs[OBJ_CNT / 2];
+  kmem_cache_free (cache, obj);
+  objs[OBJ_CNT / 2] = kmem_cache_alloc (cache);
+  if (objs[OBJ_CNT / 2] != obj)
+    fail ("freed object %p did not come back first (got %p)",
+          obj, objs[OBJ_CNT / 2]);
+  if (ctor_cnt != ctors)
+    fail ("reused object was constructed again");
+  msg ("Most recently freed object came back first.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+  kmem_cache_destroy (cache);
+  msg ("Destroyed the cache.");
+}
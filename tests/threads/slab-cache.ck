@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocated 200 aligned, constructed objects.
+(slab-cache) Most recently freed object came back first.
+(slab-cache) Destroyed the cache.
+(slab-cache) end
+EOF
+pass;
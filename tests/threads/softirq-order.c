@@ -0,0 +1,71 @@
+/* Checks that deferred work runs after the interrupt that
+   follows its queueing, highest priority first and in the order
+   queued within a priority, in interrupt context but with
+   interrupts on, and that queueing an item twice has no
+   effect. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/softirq.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 4
+
+struct item
+  {
+    const char *name;           /* Name to print. */
+    struct work work;
+    bool in_context;            /* Ran with intr_context() true? */
+    bool intr_on;               /* Ran with interrupts on? */
+  };
+
+static struct item *order[WORK_CNT];
+static int ran;
+
+static work_func record;
+
+void
+test_softirq_order (void)
+{
+  static const char *names[WORK_CNT] = {"low 1", "high 1", "low 2", "high 2"};
+  static struct item items[WORK_CNT];
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < WORK_CNT; i++)
+    {
+      items[i].name = names[i];
+      work_init (&items[i].work, record, &items[i]);
+    }
+
+  msg ("Queueing work.");
+  old_level = intr_disable ();
+  for (i = 0; i < WORK_CNT; i++)
+    work_queue (&items[i].work, i % 2 == 0 ? WORK_LOW : WORK_HIGH);
+  if (work_queue (&items[1].work, WORK_HIGH))
+    fail ("work queued twice.");
+  intr_set_level (old_level);
+
+  timer_sleep (2);
+
+  if (ran != WORK_CNT)
+    fail ("%d of %d work items ran.", ran, WORK_CNT);
+  for (i = 0; i < WORK_CNT; i++)
+    msg ("Work %s ran%s%s.", order[i]->name,
+         order[i]->in_context ? " in interrupt context" : "",
+         order[i]->intr_on ? " with interrupts on" : "");
+}
+
+static void
+record (void *item_)
+{
+  struct item *item = item_;
+
+  item->in_context = intr_context ();
+  item->intr_on = intr_get_level () == INTR_ON;
+  if (ran < WORK_CNT)
+    order[ran] = item;
+  ran++;
+}
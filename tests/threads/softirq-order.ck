@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(softirq-order) begin
+(softirq-order) Queueing work.
+(softirq-order) Work high 1 ran in interrupt context with interrupts on.
+(softirq-order) Work high 2 ran in interrupt context with interrupts on.
+(softirq-order) Work low 1 ran in interrupt context with interrupts on.
+(softirq-order) Work low 2 ran in interrupt context with interrupts on.
+(softirq-order) end
+EOF
+pass;
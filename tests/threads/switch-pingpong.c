@@ -0,0 +1,66 @@
+/* Measures context switch speed.
+
+   The main thread and a partner thread of equal priority bounce
+   control back and forth through two semaphores, so every round
+   trip is two context switches.  Reports the number of switches
+   per second, as measured by the timer. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUND_CNT 100000
+
+struct pingpong 
+  {
+    struct semaphore ping;
+    struct semaphore pong;
+  };
+
+static thread_func pong_thread;
+
+void
+test_switch_pingpong (void) 
+{
+  struct pingpong pp;
+  int64_t start_time, elapsed;
+  int i;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  thread_create ("pong", PRI_DEFAULT, pong_thread, &pp);
+
+  msg ("Bouncing %d round trips...", ROUND_CNT);
+  start_time = timer_ticks ();
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  elapsed = timer_elapsed (start_time);
+
+  if (elapsed > 0)
+    msg ("%"PRId64" switches per second.",
+         2 * ROUND_CNT * (int64_t) TIMER_FREQ / elapsed);
+  else
+    msg ("more than %"PRId64" switches per second.",
+         2 * ROUND_CNT * (int64_t) TIMER_FREQ);
+  pass ();
+}
+
+static void
+pong_thread (void *pp_) 
+{
+  struct pingpong *pp = pp_;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+}
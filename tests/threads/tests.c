@@ -29,6 +29,22 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"thread-stats", test_thread_stats},
+    {"cfs-nice", test_cfs_nice},
+    {"switch-pingpong", test_switch_pingpong},
+    {"priority-donate-many", test_priority_donate_many},
+    {"priority-donate-wakeup", test_priority_donate_wakeup},
+    {"rwlock-readers", test_rwlock_readers},
+    {"softirq-order", test_softirq_order},
+    {"wakeup-latency", test_wakeup_latency},
+    {"lock-bench", test_lock_bench},
+    {"palloc-buddy", test_palloc_buddy},
+    {"palloc-zero", test_palloc_zero},
+    {"slab-cache", test_slab_cache},
+    {"malloc-bench", test_malloc_bench},
+    {"malloc-large", test_malloc_large},
+    {"futex-wake", test_futex_wake},
+    {"hrtimer-sleep", test_hrtimer_sleep},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +54,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-many-blocked", test_mlfqs_many_blocked},
   };
 
 static const char *test_name;
@@ -19,6 +19,22 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_thread_stats;
+extern test_func test_cfs_nice;
+extern test_func test_switch_pingpong;
+extern test_func test_priority_donate_many;
+extern test_func test_priority_donate_wakeup;
+extern test_func test_rwlock_readers;
+extern test_func test_softirq_order;
+extern test_func test_wakeup_latency;
+extern test_func test_lock_bench;
+extern test_func test_palloc_buddy;
+extern test_func test_palloc_zero;
+extern test_func test_slab_cache;
+extern test_func test_malloc_bench;
+extern test_func test_malloc_large;
+extern test_func test_futex_wake;
+extern test_func test_hrtimer_sleep;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
@@ -32,6 +48,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_many_blocked;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
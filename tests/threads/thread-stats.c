@@ -0,0 +1,62 @@
+/* Checks the per-thread scheduling statistics.
+
+   The main thread sleeps a few times, which blocks it and later
+   puts it back on the ready queue, and then yields to another
+   thread of equal priority, which is an involuntary switch.
+   Timer preemption may add more ready waits and involuntary
+   switches, but never voluntary ones. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEP_CNT 5
+
+static thread_func spin_thread;
+
+void
+test_thread_stats (void) 
+{
+  struct thread_stats before, after;
+  int64_t hist_total;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_get_stats (&before);
+  for (i = 0; i < SLEEP_CNT; i++)
+    timer_sleep (1);
+  thread_get_stats (&after);
+
+  if (after.voluntary_switches - before.voluntary_switches != SLEEP_CNT)
+    fail ("%lld voluntary switches for %d sleeps",
+          after.voluntary_switches - before.voluntary_switches, SLEEP_CNT);
+  if (after.ready_waits - before.ready_waits < SLEEP_CNT)
+    fail ("%lld ready waits for %d sleeps",
+          after.ready_waits - before.ready_waits, SLEEP_CNT);
+
+  hist_total = 0;
+  for (i = 0; i < THREAD_STATS_BUCKETS; i++)
+    hist_total += after.ready_hist[i];
+  if (hist_total != after.ready_waits)
+    fail ("histogram holds %lld waits, expected %lld",
+          hist_total, after.ready_waits);
+  msg ("sleeping counted as voluntary switches");
+
+  thread_create ("spinner", PRI_DEFAULT, spin_thread, NULL);
+  thread_get_stats (&before);
+  thread_yield ();
+  thread_get_stats (&after);
+  if (after.involuntary_switches - before.involuntary_switches < 1)
+    fail ("%lld involuntary switches for 1 yield",
+          after.involuntary_switches - before.involuntary_switches);
+  msg ("yielding counted as an involuntary switch");
+}
+
+static void
+spin_thread (void *aux UNUSED) 
+{
+}
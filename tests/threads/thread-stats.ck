@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-stats) begin
+(thread-stats) sleeping counted as voluntary switches
+(thread-stats) yielding counted as an involuntary switch
+(thread-stats) end
+EOF
+pass;
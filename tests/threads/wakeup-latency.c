@@ -0,0 +1,118 @@
+/* Measures how long a higher-priority thread takes to run after
+   being woken, and checks the order in which the threads then
+   run.
+
+   The main thread wakes a higher-priority partner through a
+   semaphore, reading the TSC just before sema_up(); the partner
+   reads it again as soon as sema_down() returns.  The partner
+   should run at once, and once it blocks again, the main thread
+   should resume ahead of a ready thread of its own priority.
+   Finally, thread_yield_to() should pass the CPU to the thread
+   named, ahead of one that has been ready longer. */
+
+#include <inttypes.h>
+#include <intrinsic.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUND_CNT 1000
+
+struct latency 
+  {
+    struct semaphore go;
+    uint64_t wake_tsc;          /* TSC just before sema_up(). */
+    uint64_t total_cycles;      /* Sum of wakeup latencies. */
+    uint64_t max_cycles;        /* Longest wakeup latency. */
+    int rounds;                 /* Rounds completed by the partner. */
+  };
+
+static thread_func waiter_thread;
+static thread_func bystander_thread;
+static thread_func record_thread;
+
+static char order[8];
+static size_t order_cnt;
+
+void
+test_wakeup_latency (void) 
+{
+  struct latency l;
+  bool bystander_ran = false;
+  tid_t second;
+  int i;
+
+  /* This test does not work with the MLFQS or the CFS. */
+  ASSERT (!thread_mlfqs && !thread_cfs);
+
+  sema_init (&l.go, 0);
+  l.total_cycles = l.max_cycles = 0;
+  l.rounds = 0;
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter_thread, &l);
+
+  /* A freshly woken, higher-priority thread must have run, and
+     blocked again, by the time sema_up() returns.  The waiter
+     just ran, so we start a fresh time slice here, and must
+     resume before the bystander does. */
+  thread_create ("bystander", PRI_DEFAULT, bystander_thread, &bystander_ran);
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      l.wake_tsc = rdtsc ();
+      sema_up (&l.go);
+      if (l.rounds != i + 1)
+        fail ("waiter did not run at once in round %d", i);
+      if (i == 0 && bystander_ran)
+        fail ("bystander ran before the waker resumed");
+    }
+  msg ("Woke waiter %d times.", ROUND_CNT);
+  msg ("Wakeup latency: %"PRIu64" cycles average, %"PRIu64" max.",
+       l.total_cycles / ROUND_CNT, l.max_cycles);
+  thread_yield ();
+  if (!bystander_ran)
+    fail ("bystander did not run on yield");
+
+  /* thread_yield_to() picks the second of two ready threads. */
+  thread_create ("first", PRI_DEFAULT, record_thread, "1");
+  second = thread_create ("second", PRI_DEFAULT, record_thread, "2");
+  if (!thread_yield_to (second))
+    fail ("thread_yield_to() did not switch to the thread named");
+  thread_yield ();
+  order[order_cnt] = '\0';
+  msg ("Run order after thread_yield_to(): %s.", order);
+}
+
+static void
+waiter_thread (void *l_) 
+{
+  struct latency *l = l_;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      uint64_t cycles;
+
+      sema_down (&l->go);
+      cycles = rdtsc () - l->wake_tsc;
+      l->total_cycles += cycles;
+      if (cycles > l->max_cycles)
+        l->max_cycles = cycles;
+      l->rounds++;
+    }
+}
+
+static void
+bystander_thread (void *ran_) 
+{
+  bool *ran = ran_;
+
+  *ran = true;
+}
+
+static void
+record_thread (void *name_) 
+{
+  const char *name = name_;
+
+  order[order_cnt++] = *name;
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $line ('(wakeup-latency) Woke waiter 1000 times.',
+		  '(wakeup-latency) Run order after thread_yield_to(): 21.',
+		  '(wakeup-latency) end') {
+    fail "missing \"$line\" in output" unless grep ($_ eq $line, @output);
+}
+
+pass;
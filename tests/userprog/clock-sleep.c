@@ -0,0 +1,77 @@
+/* Checks that clock_gettime() keeps time in steps much finer
+   than a timer tick, and that nanosleep() sleeps at least as
+   long as it is asked to, without rounding short sleeps up to
+   whole timer ticks.  Also checks that both calls refuse
+   buffers that are not wholly in user memory, including ones
+   that wrap past the top of the address space. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SLEEP_CNT 20
+#define SLEEP_NS 500000         /* 0.5 ms. */
+
+static int64_t
+ns (const struct timespec *ts)
+{
+  return ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+void
+test_main (void) 
+{
+  struct timespec start, now, nap = {0, SLEEP_NS}, bad = {0, 1000000000};
+  int64_t elapsed;
+  int i;
+
+  CHECK (clock_gettime (CLOCK_MONOTONIC, &start) == 0, "clock_gettime");
+  CHECK (clock_gettime (CLOCK_MONOTONIC + 1, &now) == -1,
+         "clock_gettime on an unknown clock fails");
+  CHECK (clock_gettime (CLOCK_MONOTONIC, NULL) == -1,
+         "clock_gettime into a null buffer fails");
+  CHECK (nanosleep (&bad) == -1, "nanosleep with too many nanoseconds fails");
+  CHECK (clock_gettime (CLOCK_MONOTONIC,
+                        (struct timespec *) 0x8004000000) == -1,
+         "clock_gettime into kernel memory fails");
+  CHECK (clock_gettime (CLOCK_MONOTONIC,
+                        (struct timespec *) (UINTPTR_MAX - 7)) == -1,
+         "clock_gettime into a buffer that wraps fails");
+  CHECK (nanosleep ((struct timespec *) (UINTPTR_MAX - 7)) == -1,
+         "nanosleep from a buffer that wraps fails");
+
+  /* Two readings in a row should differ by far less than a
+     millisecond, the least a tick-based clock could show. */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  do
+    clock_gettime (CLOCK_MONOTONIC, &now);
+  while (ns (&now) == ns (&start));
+  if (ns (&now) - ns (&start) >= 1000000)
+    fail ("clock advanced by %lld ns at once",
+          (long long) (ns (&now) - ns (&start)));
+  msg ("clock_gettime has sub-millisecond resolution");
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < SLEEP_CNT; i++)
+    {
+      struct timespec before, after;
+
+      clock_gettime (CLOCK_MONOTONIC, &before);
+      if (nanosleep (&nap) != 0)
+        fail ("nanosleep failed");
+      clock_gettime (CLOCK_MONOTONIC, &after);
+      if (ns (&after) - ns (&before) < SLEEP_NS)
+        fail ("nanosleep returned after %lld of %d ns",
+              (long long) (ns (&after) - ns (&before)), SLEEP_NS);
+    }
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  elapsed = ns (&now) - ns (&start);
+
+  /* With 10 ms ticks, rounding each sleep up to a tick would take
+     at least 200 ms. */
+  if (elapsed >= SLEEP_CNT * SLEEP_NS * 10)
+    fail ("%d sleeps of %d ns took %lld ns",
+          SLEEP_CNT, SLEEP_NS, (long long) elapsed);
+  msg ("short sleeps are not rounded up to ticks");
+}
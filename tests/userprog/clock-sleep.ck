@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clock-sleep) begin
+(clock-sleep) clock_gettime
+(clock-sleep) clock_gettime on an unknown clock fails
+(clock-sleep) clock_gettime into a null buffer fails
+(clock-sleep) nanosleep with too many nanoseconds fails
+(clock-sleep) clock_gettime into kernel memory fails
+(clock-sleep) clock_gettime into a buffer that wraps fails
+(clock-sleep) nanosleep from a buffer that wraps fails
+(clock-sleep) clock_gettime has sub-millisecond resolution
+(clock-sleep) short sleeps are not rounded up to ticks
+(clock-sleep) end
+clock-sleep: exit(0)
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Exercises the futex system calls and the user-level mutex
+   and condition variable built on them, within one process. */
+
+#include <syscall.h>
+#include <synch.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int word = 7;
+
+void
+test_main (void) 
+{
+  struct mutex mutex;
+  struct condvar cond;
+
+  CHECK (futex_wait (&word, 8, FUTEX_FOREVER) == FUTEX_AGAIN,
+         "futex_wait on a changed word returns at once");
+  CHECK (futex_wait (&word, 7, 20) == FUTEX_TIMEDOUT,
+         "futex_wait times out");
+  CHECK (futex_wake (&word, 1) == 0, "futex_wake with no waiters");
+  CHECK (futex_wait ((int *) ((char *) &word + 1), 7, 0) == FUTEX_FAULT,
+         "futex_wait on a misaligned word");
+  CHECK (futex_wake (NULL, 1) == FUTEX_FAULT, "futex_wake on a null word");
+
+  mutex_init (&mutex);
+  condvar_init (&cond);
+  mutex_lock (&mutex);
+  CHECK (!mutex_trylock (&mutex), "mutex_trylock on a locked mutex");
+  CHECK (!condvar_timedwait (&cond, &mutex, 20), "condvar_timedwait times out");
+  CHECK (!mutex_trylock (&mutex), "mutex is held again after the wait");
+  mutex_unlock (&mutex);
+  CHECK (mutex_trylock (&mutex), "mutex_trylock on an unlocked mutex");
+  mutex_unlock (&mutex);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-basic) begin
+(futex-basic) futex_wait on a changed word returns at once
+(futex-basic) futex_wait times out
+(futex-basic) futex_wake with no waiters
+(futex-basic) futex_wait on a misaligned word
+(futex-basic) futex_wake on a null word
+(futex-basic) mutex_trylock on a locked mutex
+(futex-basic) condvar_timedwait times out
+(futex-basic) mutex is held again after the wait
+(futex-basic) mutex_trylock on an unlocked mutex
+(futex-basic) end
+futex-basic: exit(0)
+EOF
+pass;
@@ -0,0 +1,22 @@
+/* Passes thread_stats() buffers that are not wholly in user
+   memory, including one whose end wraps past the top of the
+   address space, and checks that each call fails with -1
+   instead of writing through the bad pointer. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct thread_stats stats;
+
+  CHECK (thread_stats (&stats) == 0, "thread_stats");
+  CHECK (thread_stats (NULL) == -1, "thread_stats into a null buffer fails");
+  CHECK (thread_stats ((struct thread_stats *) 0x8004000000) == -1,
+         "thread_stats into kernel memory fails");
+  CHECK (thread_stats ((struct thread_stats *) (UINTPTR_MAX - 7)) == -1,
+         "thread_stats into a buffer that wraps fails");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-stats-bad-ptr) begin
+(thread-stats-bad-ptr) thread_stats
+(thread-stats-bad-ptr) thread_stats into a null buffer fails
+(thread-stats-bad-ptr) thread_stats into kernel memory fails
+(thread-stats-bad-ptr) thread_stats into a buffer that wraps fails
+(thread-stats-bad-ptr) end
+thread-stats-bad-ptr: exit(0)
+EOF
+pass;
@@ -1,96 +1,70 @@
-#include <stdint.h>
-
-#define f (1 << 14)
-
-int 
-int_to_fixed_pt(int n);
-
-int 
-fixed_pt_to_int_zero(int x);
-
-int 
-fixed_pt_to_int_nearest(int x);
-
-int
-add_fixed_pts(int x,int y);
-
-int 
-sub_fixed_pts(int x,int y);
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
 
-int
-add_fixed_pt_with_int(int n,int x);
-
-int 
-sub_fixed_pt_with_int(int n,int x);
-
-int
-mul_fixed_pts(int x, int y);
-
-int 
-mul_fixed_pt_with_int(int x,int n);
+#include <stdint.h>
 
-int
-div_fixed_pts(int x, int y);
+/* 17.14 fixed-point arithmetic for the MLFQS scheduler.
 
-int 
-div_fixed_pt_with_int(int x,int n);
+   These run inside the timer interrupt, so they are static
+   inline: each use compiles to one or two instructions instead
+   of an out-of-line call. */
 
+#define FP_SHIFT 14
+#define FP_F (1 << FP_SHIFT)
 
-int 
-int_to_fixed_pt(int n){
-    return n * f;
+static inline int
+int_to_fixed_pt (int n) {
+	return n * FP_F;
 }
 
-int 
-fixed_pt_to_int_zero(int x){
-    return x / f;
+static inline int
+fixed_pt_to_int_zero (int x) {
+	return x / FP_F;
 }
 
-int 
-fixed_pt_to_int_nearest(int x){
-    return x >= 0 ? (x + f / 2) / f : (x - f / 2) / f;
+static inline int
+fixed_pt_to_int_nearest (int x) {
+	return x >= 0 ? (x + FP_F / 2) / FP_F : (x - FP_F / 2) / FP_F;
 }
 
-int
-add_fixed_pts(int x,int y){
-    return x + y;
+static inline int
+add_fixed_pts (int x, int y) {
+	return x + y;
 }
 
-int 
-sub_fixed_pts(int x,int y){
-    return x - y;
+static inline int
+sub_fixed_pts (int x, int y) {
+	return x - y;
 }
 
-int
-add_fixed_pt_with_int(int n,int x){
-   return  x + int_to_fixed_pt(n);
+static inline int
+add_fixed_pt_with_int (int n, int x) {
+	return x + int_to_fixed_pt (n);
 }
 
-int 
-sub_fixed_pt_with_int(int n,int x){
-   return  x - int_to_fixed_pt(n);
+static inline int
+sub_fixed_pt_with_int (int n, int x) {
+	return x - int_to_fixed_pt (n);
 }
 
-int
-mul_fixed_pts(int x, int y){
-    return ((int64_t) x) * y / f;
+static inline int
+mul_fixed_pts (int x, int y) {
+	return ((int64_t) x) * y / FP_F;
 }
 
-int 
-mul_fixed_pt_with_int(int x,int n){
-    return x * n;
+static inline int
+mul_fixed_pt_with_int (int x, int n) {
+	return x * n;
 }
 
-int
-div_fixed_pts(int x, int y){
-    return ((int64_t) x) * f / y;
+static inline int
+div_fixed_pts (int x, int y) {
+	return ((int64_t) x) * FP_F / y;
 }
 
-int 
-div_fixed_pt_with_int(int x,int n){
-    return x / n;
+static inline int
+div_fixed_pt_with_int (int x, int n) {
+	return x / n;
 }
 
-
-
-
+#endif /* threads/fixed_point.h */
@@ -0,0 +1,159 @@
+#include "threads/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Fast user-space mutexes.
+
+   A futex is an int in memory.  A user process checks and
+   updates the int with atomic instructions of its own and asks
+   the kernel for help only to sleep until the int changes, with
+   futex_wait(), or to wake the threads sleeping on it, with
+   futex_wake().  The system call layer translates the user
+   address into the kernel address that these functions take;
+   kernel threads may also call them directly.
+
+   Sleeping threads are kept in a fixed-size hash table of wait
+   queues, keyed by the physical address of the futex word, so
+   that processes that map the same page at different virtual
+   addresses still meet in the same queue.  All access happens
+   with interrupts off. */
+
+/* Number of hash buckets.  Must be a power of 2. */
+#define FUTEX_BUCKETS 64
+
+static struct list futex_buckets[FUTEX_BUCKETS];
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter {
+	struct list_elem elem;              /* Element in a bucket. */
+	uintptr_t key;                      /* Physical address waited on. */
+	struct thread *thread;              /* The sleeping thread. */
+	bool woken;                         /* Woken by futex_wake()? */
+	struct hrtimer timeout;             /* Expires the wait, if timed. */
+};
+
+static struct list *futex_bucket (uintptr_t key);
+static hrtimer_func futex_timeout;
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) {
+	size_t i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++)
+		list_init (&futex_buckets[i]);
+}
+
+/* If the int at kernel address ADDR holds EXPECTED, sleeps until
+   futex_wake() is called on it or TIMEOUT_MS milliseconds have
+   passed, whichever comes first.  A negative TIMEOUT_MS never
+   expires, and neither does one too long to count in
+   nanoseconds.  Returns FUTEX_WOKEN, FUTEX_TIMEDOUT, or FUTEX_AGAIN
+   if the int did not hold EXPECTED.
+
+   Checking the int and going to sleep happen atomically with
+   respect to futex_wake(), so a wakeup that follows a change to
+   the int cannot be lost. */
+int
+futex_wait (int *addr, int expected, int64_t timeout_ms) {
+	struct futex_waiter w;
+	enum intr_level old_level;
+	int result;
+
+	ASSERT (futex_valid (addr));
+	ASSERT (!intr_context ());
+
+	if (timeout_ms > INT64_MAX / 1000000)
+		timeout_ms = FUTEX_FOREVER;
+
+	w.key = vtop (addr);
+	old_level = intr_disable ();
+	if (*addr != expected)
+		result = FUTEX_AGAIN;
+	else if (timeout_ms == 0)
+		result = FUTEX_TIMEDOUT;
+	else {
+		w.thread = thread_current ();
+		w.woken = false;
+		w.timeout.pending = false;
+		list_push_back (futex_bucket (w.key), &w.elem);
+		if (timeout_ms > 0)
+			hrtimer_start (&w.timeout, timer_clock_ns () + timeout_ms * 1000000,
+					futex_timeout, &w);
+		thread_block ();
+
+		if (timeout_ms > 0)
+			hrtimer_cancel (&w.timeout);
+		result = w.woken ? FUTEX_WOKEN : FUTEX_TIMEDOUT;
+	}
+	intr_set_level (old_level);
+	return result;
+}
+
+/* Wakes up to WAKE_CNT threads sleeping in futex_wait() on the
+   int at kernel address ADDR, in the order they went to sleep,
+   and yields if one of them outranks the running thread.
+   Returns the number of threads woken. */
+int
+futex_wake (int *addr, int wake_cnt) {
+	enum intr_level old_level;
+	struct list *bucket;
+	struct list_elem *e;
+	uintptr_t key;
+	int woken = 0;
+	bool preempt = false;
+
+	ASSERT (futex_valid (addr));
+	ASSERT (!intr_context ());
+
+	key = vtop (addr);
+	old_level = intr_disable ();
+	bucket = futex_bucket (key);
+	for (e = list_begin (bucket); e != list_end (bucket) && woken < wake_cnt; ) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+		e = list_next (e);
+		if (w->key == key) {
+			list_remove (&w->elem);
+			w->woken = true;
+			thread_unblock (w->thread);
+			preempt |= w->thread->priority > thread_current ()->priority;
+			woken++;
+		}
+	}
+	intr_set_level (old_level);
+
+	if (preempt && !thread_cfs)
+		thread_yield ();
+	return woken;
+}
+
+/* Returns true if ADDR is an aligned kernel address that can
+   serve as a futex. */
+bool
+futex_valid (const int *addr) {
+	return is_kernel_vaddr (addr) && (uintptr_t) addr % sizeof *addr == 0;
+}
+
+/* Returns the wait queue for KEY. */
+static struct list *
+futex_bucket (uintptr_t key) {
+	return &futex_buckets[hash_int (key / sizeof (int)) & (FUTEX_BUCKETS - 1)];
+}
+
+/* Ends the wait of the futex_waiter W_, unless it was woken
+   first.  Runs in the timer interrupt. */
+static void
+futex_timeout (struct hrtimer *hr UNUSED, void *w_) {
+	struct futex_waiter *w = w_;
+
+	if (!w->woken) {
+		list_remove (&w->elem);
+		thread_unblock (w->thread);
+	}
+}
@@ -10,16 +10,21 @@
 #include <string.h>
 #include "devices/kbd.h"
 #include "devices/input.h"
+#include "devices/lapic.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/futex.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
+#include "threads/lockstat.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/sched_trace.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -56,6 +61,7 @@ static void paging_init (uint64_t mem_end);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
+static enum timer_source parse_timer_source (const char *);
 static void run_actions (char **argv);
 static void usage (void);
 
@@ -85,6 +91,7 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	kmem_cache_init ();
 	paging_init (mem_end);
 
 #ifdef USERPROG
@@ -94,9 +101,11 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	lapic_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
+	futex_init ();
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
@@ -221,6 +230,16 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-cfs"))
+			thread_cfs = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-timer"))
+			timer_source = parse_timer_source (value);
+		else if (!strcmp (name, "-hz") && value != NULL)
+			timer_freq = atoi (value);
+		else if (!strcmp (name, "-thread-stats"))
+			thread_exit_stats = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -231,9 +250,26 @@ parse_options (char **argv) {
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
 
+	if (thread_mlfqs && thread_cfs)
+		PANIC ("-mlfqs and -cfs are mutually exclusive");
+
 	return argv;
 }
 
+/* Returns the timer tick source named NAME. */
+static enum timer_source
+parse_timer_source (const char *name) {
+	if (name == NULL)
+		PANIC ("-timer requires a value (use -h for help)");
+	else if (!strcmp (name, "pit"))
+		return TIMER_PIT;
+	else if (!strcmp (name, "lapic"))
+		return TIMER_LAPIC;
+	else if (!strcmp (name, "deadline"))
+		return TIMER_DEADLINE;
+	PANIC ("unknown timer `%s' (use -h for help)", name);
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv) {
@@ -326,6 +362,11 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -cfs               Use completely fair scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -timer=SOURCE      Drive the tick from pit, lapic or deadline.\n"
+			"  -hz=FREQ           Take FREQ timer ticks per second (19...1000).\n"
+			"  -thread-stats      Print each thread's statistics on exit.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -354,6 +395,11 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	kmem_cache_print_stats ();
+	intr_print_stats ();
+	lockstat_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,4 +408,5 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+	sched_trace_dump ();
 }
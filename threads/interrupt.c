@@ -8,7 +8,9 @@
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/softirq.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -18,6 +20,12 @@
 /* Number of x86_64 interrupts. */
 #define INTR_CNT 256
 
+/* External interrupts come from the PIC, or from the local APIC
+   itself, which they must be acknowledged to. */
+#define is_pic_vec(VEC) ((VEC) >= 0x20 && (VEC) <= 0x2f)
+#define is_lapic_vec(VEC) ((VEC) >= LAPIC_TIMER_VEC && (VEC) < LAPIC_SPURIOUS_VEC)
+#define is_external_vec(VEC) (is_pic_vec (VEC) || is_lapic_vec (VEC))
+
 /* Creates an gate that invokes FUNCTION.
 
    The gate has descriptor privilege level DPL, meaning that it
@@ -99,10 +107,27 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
+   interrupt returns.
+
+   Work that a handler defers with work_queue() runs right after
+   the handler, with interrupts on.  An external interrupt that
+   arrives then is handled at once, which is the only way that
+   external interrupts nest.  It leaves the work it queues, and
+   its request to yield, to the interrupt it nested in. */
 static bool in_external_intr;   /* Are we processing an external interrupt? */
+static bool in_softirq;         /* Are we running deferred work? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Longest stretch with interrupts off.  A stretch starts when
+   intr_disable() turns interrupts off, or when an interrupt gate
+   does, and ends when intr_enable() or an interrupt return turns
+   them back on.  Stretches whose start was not seen, such as
+   the one from boot to thread_start(), are not counted. */
+static uint64_t intr_off_tsc;   /* When the current stretch began, or 0. */
+static void *intr_off_site;     /* Code that began it. */
+static uint64_t intr_off_max;   /* Longest stretch seen, in TSC cycles. */
+static void *intr_off_max_site; /* Code that began it. */
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -110,6 +135,8 @@ static void pic_end_of_interrupt (int irq);
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
 
+static enum intr_level intr_disable_at (void *site);
+
 /* Returns the current interrupt status. */
 enum intr_level
 intr_get_level (void) {
@@ -128,14 +155,19 @@ intr_get_level (void) {
    returns the previous interrupt status. */
 enum intr_level
 intr_set_level (enum intr_level level) {
-	return level == INTR_ON ? intr_enable () : intr_disable ();
+	if (level == INTR_ON)
+		return intr_enable ();
+	return intr_disable_at (__builtin_return_address (0));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_enable (void) {
 	enum intr_level old_level = intr_get_level ();
-	ASSERT (!intr_context ());
+	ASSERT (!in_external_intr);
+
+	if (old_level == INTR_OFF)
+		intr_off_end ();
 
 	/* Enable interrupts by setting the interrupt flag.
 
@@ -149,8 +181,20 @@ intr_enable (void) {
 /* Disables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_disable (void) {
+	return intr_disable_at (__builtin_return_address (0));
+}
+
+/* Disables interrupts on behalf of the code at SITE and returns
+   the previous interrupt status. */
+static enum intr_level
+intr_disable_at (void *site) {
 	enum intr_level old_level = intr_get_level ();
 
+	if (old_level == INTR_ON) {
+		intr_off_tsc = rdtsc ();
+		intr_off_site = site;
+	}
+
 	/* Disable interrupts by clearing the interrupt flag.
 	   See [IA32-v2b] "CLI" and [IA32-v3a] 5.8.1 "Masking Maskable
 	   Hardware Interrupts". */
@@ -159,6 +203,28 @@ intr_disable (void) {
 	return old_level;
 }
 
+/* Ends the current stretch with interrupts off, because they are
+   about to be turned on by other means than intr_enable(). */
+void
+intr_off_end (void) {
+	if (intr_off_tsc != 0) {
+		uint64_t cycles = rdtsc () - intr_off_tsc;
+		if (cycles > intr_off_max) {
+			intr_off_max = cycles;
+			intr_off_max_site = intr_off_site;
+		}
+		intr_off_tsc = 0;
+	}
+}
+
+/* Prints the longest stretch with interrupts off. */
+void
+intr_print_stats (void) {
+	printf ("Interrupts: off for at most %"PRIu64" cycles at a time, "
+			"from %p\n", intr_off_max, intr_off_max_site);
+	softirq_print_stats ();
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
@@ -166,6 +232,7 @@ intr_init (void) {
 
 	/* Initialize interrupt controller. */
 	pic_init ();
+	softirq_init ();
 
 	/* Initialize IDT. */
 	for (i = 0; i < INTR_CNT; i++) {
@@ -227,7 +294,7 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external_vec (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -248,15 +315,16 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external_vec (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including the deferred work run at its end, and false at all
+   other times. */
 bool
 intr_context (void) {
-	return in_external_intr;
+	return in_external_intr || in_softirq;
 }
 
 /* During processing of an external interrupt, directs the
@@ -337,13 +405,24 @@ intr_handler (struct intr_frame *frame) {
 	   We only handle one at a time (so interrupts must be off)
 	   and they need to be acknowledged on the PIC (see below).
 	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	external = is_external_vec (frame->vec_no);
+
+	/* An interrupt gate turned interrupts off. */
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF) {
+		intr_off_tsc = rdtsc ();
+		intr_off_site = (void *) intr_handlers[frame->vec_no];
+	}
+
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
-		ASSERT (!intr_context ());
+		ASSERT (!in_external_intr);
 
 		in_external_intr = true;
-		yield_on_return = false;
+		if (!in_softirq)
+			yield_on_return = false;
+
+		/* Catch up on ticks skipped while idle, if any. */
+		timer_idle_exit ();
 	}
 
 	/* Invoke the interrupt's handler. */
@@ -367,11 +446,27 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
-
-		if (yield_on_return)
-			thread_yield ();
+		if (is_pic_vec (frame->vec_no))
+			pic_end_of_interrupt (frame->vec_no);
+		else
+			lapic_eoi ();
+
+		/* Run deferred work, unless this interrupt arrived while
+		   it was running, in which case the interrupted work
+		   loop picks up anything new. */
+		if (!in_softirq) {
+			in_softirq = true;
+			softirq_run ();
+			in_softirq = false;
+
+			if (yield_on_return)
+				thread_yield ();
+		}
 	}
+
+	/* The interrupt return turns interrupts back on. */
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		intr_off_end ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
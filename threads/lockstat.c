@@ -0,0 +1,55 @@
+#include "threads/lockstat.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+#ifdef LOCKSTAT
+/* Registered locks, in order of registration. */
+static struct lockstat *lockstat_head;
+static struct lockstat **lockstat_tail = &lockstat_head;
+
+/* Gives LOCK a name, formatted printf()-style from FORMAT, and
+   adds it to the locks listed by lockstat_print_stats().  LOCK
+   must already be initialized, and must exist until shutdown:
+   register only locks with static lifetime, or that live in
+   structures that are never freed. */
+void
+lockstat_register (struct lock *lock, const char *format, ...) {
+	struct lockstat *stat = &lock->stat;
+	enum intr_level old_level;
+	va_list args;
+
+	ASSERT (stat->name[0] == '\0');
+
+	va_start (args, format);
+	vsnprintf (stat->name, sizeof stat->name, format, args);
+	va_end (args);
+
+	old_level = intr_disable ();
+	stat->next = NULL;
+	*lockstat_tail = stat;
+	lockstat_tail = &stat->next;
+	intr_set_level (old_level);
+}
+
+/* Prints the statistics of each registered lock. */
+void
+lockstat_print_stats (void) {
+	struct lockstat *s;
+
+	for (s = lockstat_head; s != NULL; s = s->next) {
+		printf ("Lock %s: %"PRIu64" acquires, %"PRIu64" contended\n",
+				s->name, s->acquire_cnt, s->contend_cnt);
+		if (s->acquire_cnt == 0)
+			continue;
+		printf ("Lock %s: held %"PRIu64" cycles avg, %"PRIu64" max\n",
+				s->name, s->hold_cycles / s->acquire_cnt, s->max_hold_cycles);
+		if (s->contend_cnt != 0)
+			printf ("Lock %s: waited %"PRIu64" cycles avg, %"PRIu64" max "
+					"(from %p)\n", s->name, s->wait_cycles / s->contend_cnt,
+					s->max_wait_cycles, s->max_wait_site);
+	}
+}
+#endif
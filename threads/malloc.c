@@ -7,15 +7,16 @@
 #include <string.h>
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
    The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   of 2, or above 1 kB to 3, 6 or 12 kB, and assigned to the
+   "descriptor" that manages blocks of that size.  The
+   descriptor keeps a list of free blocks.  If the free list is
+   nonempty, one of its blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -26,22 +27,58 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
-
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   and give the arena back to the page allocator, unless it is
+   the descriptor's only such arena.  Keeping one empty arena
+   stops a block that is freed and allocated over and over from
+   handing its page back and forth with the page allocator.
+
+   In front of the free lists, each thread keeps a "magazine" of
+   free blocks for each descriptor: a short stack, linked
+   through the blocks themselves, that only its own thread
+   touches, so that most calls take no lock at all.  An empty
+   magazine is refilled with a batch of blocks from the free
+   list, and a full one gives a batch back, each under a single
+   acquisition of the descriptor's lock.  Blocks in a magazine
+   count as in use as far as their arena is concerned.
+   malloc_drain() empties the magazines of a thread that is
+   exiting.  Magazines are per thread rather than per CPU because
+   the kernel runs on a single CPU.
+
+   Blocks bigger than 1 kB would waste much of a single page, so
+   the descriptors for 3, 6 and 12 kB blocks use arenas of
+   several pages instead, big enough to hold at least
+   MULTI_MIN_BLOCKS blocks.  Their blocks may straddle page
+   boundaries, so each one is preceded by a struct block_hdr that
+   points back to its arena, where a block in a single-page arena
+   finds its arena at the start of its page.
+
+   We handle blocks bigger than 12 kB by allocating contiguous
+   pages with the page allocator and sticking the allocation size
+   at the beginning of the allocated block's arena header.
+   realloc() grows such a block in place if the pages that follow
+   it are free, and shrinks it in place by freeing its last
+   pages.
+
+   Finally, malloc_print_stats() prints a histogram of the sizes
+   requested, to show how well the size classes fit them. */
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
+	size_t arena_pages;         /* Number of pages in an arena. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t arena_cnt;           /* Number of arenas. */
+	size_t mag_size;            /* Most blocks in a magazine, 0 if none. */
 	struct list free_list;      /* List of free blocks. */
+	size_t empty_cnt;           /* Arenas with no block in use. */
 	struct lock lock;           /* Lock. */
 };
 
+/* Bytes of blocks that a magazine holds at most, and most blocks
+   in a magazine of any size. */
+#define MAG_BYTES 2048
+#define MAG_MAX 16
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -52,31 +89,123 @@ struct arena {
 	size_t free_cnt;            /* Free blocks; pages in big block. */
 };
 
+/* Header in front of each block of a multi-page arena. */
+struct block_hdr {
+	struct arena *arena;        /* Owning arena. */
+	size_t idx;                 /* Index of block in arena. */
+};
+
+/* Blocks of a single-page arena, and big blocks, start right
+   after a 24-byte struct arena or another block whose size is a
+   multiple of 16, so they are never 16-byte aligned.  Blocks of
+   a multi-page arena always are, which is how we tell them
+   apart. */
+#define MULTI_ALIGN 16
+
+/* Offset of the first block in a multi-page arena. */
+#define MULTI_OFS (ROUND_UP (sizeof (struct arena), MULTI_ALIGN) \
+		+ sizeof (struct block_hdr))
+
+/* Fewest blocks in a multi-page arena. */
+#define MULTI_MIN_BLOCKS 4
+
+/* Number of buckets in the size histogram. */
+#define HIST_CNT 16
+
 /* Free block. */
 struct block {
-	struct list_elem free_elem; /* Free list element. */
+	union {
+		struct list_elem free_elem; /* Free list element. */
+		struct block *mag_next;     /* Next block in a magazine. */
+	};
 };
 
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Size histogram: size_hist[K] counts requests for more than
+   2**(K+3) bytes and at most 2**(K+4), except that the first
+   bucket also counts smaller requests and the last one all
+   larger ones. */
+static long long size_hist[HIST_CNT];
+
+static void desc_init (size_t block_size, size_t arena_pages);
+static size_t multi_blocks (size_t block_size, size_t arena_pages);
+static struct desc *size_to_desc (size_t size);
+static void hist_record (size_t size);
+static bool resize_in_place (void *block, size_t new_size);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_get_block (struct desc *);
+static void desc_put_block (struct desc *, struct block *);
+static bool mag_refill (struct desc *, struct malloc_magazine *);
+static void mag_drain (struct desc *, struct malloc_magazine *, size_t cnt);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
 	size_t block_size;
 
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
+	ASSERT (sizeof (struct arena) % MULTI_ALIGN != 0);
+
+	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+		desc_init (block_size, 1);
+	for (block_size = 3 * 1024; block_size <= 12 * 1024; block_size *= 2) {
+		size_t arena_pages = 2;
+
+		while (multi_blocks (block_size, arena_pages) < MULTI_MIN_BLOCKS)
+			arena_pages *= 2;
+		desc_init (block_size, arena_pages);
+	}
+}
+
+/* Adds a descriptor for blocks of BLOCK_SIZE bytes, a multiple
+   of 16, in arenas of ARENA_PAGES pages. */
+static void
+desc_init (size_t block_size, size_t arena_pages) {
+	struct desc *d = &descs[desc_cnt++];
+
+	ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+	ASSERT (block_size % MULTI_ALIGN == 0);
+
+	d->block_size = block_size;
+	d->arena_pages = arena_pages;
+	if (arena_pages == 1)
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	else
+		d->blocks_per_arena = multi_blocks (block_size, arena_pages);
+	d->arena_cnt = 0;
+	d->mag_size = 0;
+	if (d - descs < MALLOC_MAG_CNT) {
+		d->mag_size = MAG_BYTES / block_size;
+		if (d->mag_size > MAG_MAX)
+			d->mag_size = MAG_MAX;
 	}
+	list_init (&d->free_list);
+	d->empty_cnt = 0;
+	lock_init (&d->lock);
+	lockstat_register (&d->lock, "malloc %zu", block_size);
+}
+
+/* Returns the number of BLOCK_SIZE-byte blocks that fit in a
+   multi-page arena of ARENA_PAGES pages. */
+static size_t
+multi_blocks (size_t block_size, size_t arena_pages) {
+	return (arena_pages * PGSIZE - MULTI_OFS)
+		/ (block_size + sizeof (struct block_hdr));
+}
+
+/* Returns the smallest descriptor that satisfies a SIZE-byte
+   request, or a null pointer if SIZE is too big for any. */
+static struct desc *
+size_to_desc (size_t size) {
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++)
+		if (d->block_size >= size)
+			return d;
+	return NULL;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -90,13 +219,12 @@ malloc (size_t size) {
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
 		return NULL;
+	hist_record (size);
 
 	/* Find the smallest descriptor that satisfies a SIZE-byte
 	   request. */
-	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
-			break;
-	if (d == descs + desc_cnt) {
+	d = size_to_desc (size);
+	if (d == NULL) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
@@ -112,33 +240,21 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
+	if (d->mag_size > 0) {
+		/* Pop a block off this thread's magazine. */
+		struct malloc_magazine *m = &thread_current ()->mags[d - descs];
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
+		ASSERT (!intr_context ());
+		if (m->cnt == 0 && !mag_refill (d, m))
 			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
+		b = m->head;
+		m->head = b->mag_next;
+		m->cnt--;
+		return b;
 	}
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
+	lock_acquire (&d->lock);
+	b = desc_get_block (d);
 	lock_release (&d->lock);
 	return b;
 }
@@ -184,6 +300,9 @@ realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
+	} else if (old_block != NULL && resize_in_place (old_block, new_size)) {
+		hist_record (new_size);
+		return old_block;
 	} else {
 		void *new_block = malloc (new_size);
 		if (old_block != NULL && new_block != NULL) {
@@ -196,6 +315,32 @@ realloc (void *old_block, size_t new_size) {
 	}
 }
 
+/* Tries to make BLOCK, which holds at least NEW_SIZE bytes if it
+   is in an arena, hold NEW_SIZE bytes without moving it.  A
+   block in an arena stays put if NEW_SIZE still belongs to its
+   descriptor.  A big block stays big, and takes or gives back
+   pages at its end.  Returns true if successful. */
+static bool
+resize_in_place (void *block, size_t new_size) {
+	struct arena *a = block_to_arena (block);
+	size_t page_cnt;
+
+	if (a->desc != NULL)
+		return size_to_desc (new_size) == a->desc;
+	if (size_to_desc (new_size) != NULL)
+		return false;
+
+	page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+	if (page_cnt < a->free_cnt)
+		palloc_free_multiple ((uint8_t *) a + PGSIZE * page_cnt,
+				a->free_cnt - page_cnt);
+	else if (page_cnt > a->free_cnt
+			&& !palloc_extend (a, a->free_cnt, page_cnt))
+		return false;
+	a->free_cnt = page_cnt;
+	return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
@@ -213,23 +358,22 @@ free (void *p) {
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			if (d->mag_size > 0) {
+				/* Push it onto this thread's magazine, first making
+				   room if the magazine is full. */
+				struct malloc_magazine *m = &thread_current ()->mags[d - descs];
+
+				ASSERT (!intr_context ());
+				if (m->cnt >= d->mag_size)
+					mag_drain (d, m, DIV_ROUND_UP (d->mag_size, 2));
+				b->mag_next = m->head;
+				m->head = b;
+				m->cnt++;
+				return;
 			}
 
+			lock_acquire (&d->lock);
+			desc_put_block (d, b);
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
@@ -239,16 +383,177 @@ free (void *p) {
 	}
 }
 
+/* Prints the arenas of each descriptor and the histogram of
+   request sizes. */
+void
+malloc_print_stats (void) {
+	struct desc *d;
+	int bucket;
+
+	for (d = descs; d < descs + desc_cnt; d++)
+		if (d->arena_cnt != 0)
+			printf ("Malloc: %5zu-byte blocks: %zu arenas of %zu pages, "
+					"%zu blocks each\n", d->block_size, d->arena_cnt,
+					d->arena_pages, d->blocks_per_arena);
+	printf ("Malloc: request sizes:\n");
+	for (bucket = 0; bucket < HIST_CNT; bucket++)
+		if (size_hist[bucket] != 0) {
+			if (bucket < HIST_CNT - 1)
+				printf ("  %8s %7zu bytes: %lld\n", "up to",
+						(size_t) 16 << bucket, size_hist[bucket]);
+			else
+				printf ("  %8s %7zu bytes: %lld\n", "more than",
+						(size_t) 8 << bucket, size_hist[bucket]);
+		}
+}
+
+/* Gives every block in the current thread's magazines back to
+   the free lists.  Called by a thread that is exiting, after its
+   last call to free(). */
+void
+malloc_drain (void) {
+	struct thread *t = thread_current ();
+	size_t i;
+
+	for (i = 0; i < desc_cnt && i < MALLOC_MAG_CNT; i++)
+		if (t->mags[i].cnt > 0)
+			mag_drain (&descs[i], &t->mags[i], t->mags[i].cnt);
+}
+
+/* Takes a block off D's free list, creating a new arena first if
+   the list is empty, and returns it.  Returns a null pointer if
+   memory is not available.  D's lock must be held. */
+static struct block *
+desc_get_block (struct desc *d) {
+	struct block *b;
+	struct arena *a;
+
+	/* If the free list is empty, create a new arena. */
+	if (list_empty (&d->free_list)) {
+		size_t i;
+
+		/* Allocate pages. */
+		a = palloc_get_multiple (0, d->arena_pages);
+		if (a == NULL)
+			return NULL;
+
+		/* Initialize arena and add its blocks to the free list. */
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			if (d->arena_pages > 1) {
+				struct block_hdr *h = (struct block_hdr *) b - 1;
+				h->arena = a;
+				h->idx = i;
+			}
+			list_push_back (&d->free_list, &b->free_elem);
+		}
+		d->arena_cnt++;
+		d->empty_cnt++;
+	}
+
+	/* Get a block from free list. */
+	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+	a = block_to_arena (b);
+	if (a->free_cnt-- == d->blocks_per_arena)
+		d->empty_cnt--;
+	return b;
+}
+
+/* Adds block B to D's free list.  If that leaves B's arena
+   entirely unused and D already has an unused arena, gives B's
+   arena back to the page allocator.  D's lock must be held. */
+static void
+desc_put_block (struct desc *d, struct block *b) {
+	struct arena *a = block_to_arena (b);
+
+	/* Add block to free list. */
+	list_push_front (&d->free_list, &b->free_elem);
+
+	/* If the arena is now entirely unused, keep it if it is the
+	   only one, otherwise free it. */
+	if (++a->free_cnt >= d->blocks_per_arena) {
+		size_t i;
+
+		ASSERT (a->free_cnt == d->blocks_per_arena);
+		if (d->empty_cnt == 0) {
+			d->empty_cnt++;
+			return;
+		}
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_remove (&b->free_elem);
+		}
+		palloc_free_multiple (a, d->arena_pages);
+		d->arena_cnt--;
+	}
+}
+
+/* Moves a batch of blocks from D's free list into empty magazine
+   M.  Returns false if not even one block could be had. */
+static bool
+mag_refill (struct desc *d, struct malloc_magazine *m) {
+	size_t batch = DIV_ROUND_UP (d->mag_size, 2);
+
+	ASSERT (m->cnt == 0);
+
+	lock_acquire (&d->lock);
+	while (m->cnt < batch) {
+		struct block *b = desc_get_block (d);
+		if (b == NULL)
+			break;
+		b->mag_next = m->head;
+		m->head = b;
+		m->cnt++;
+	}
+	lock_release (&d->lock);
+
+	return m->cnt > 0;
+}
+
+/* Moves CNT blocks from magazine M back to D's free list. */
+static void
+mag_drain (struct desc *d, struct malloc_magazine *m, size_t cnt) {
+	ASSERT (cnt <= m->cnt);
+
+	lock_acquire (&d->lock);
+	for (; cnt > 0; cnt--) {
+		struct block *b = m->head;
+		m->head = b->mag_next;
+		m->cnt--;
+		desc_put_block (d, b);
+	}
+	lock_release (&d->lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a;
+
+	if ((uintptr_t) b % MULTI_ALIGN == 0) {
+		/* It's in a multi-page arena.  Check that its header
+		   really points back to it. */
+		struct block_hdr *h = (struct block_hdr *) b - 1;
+
+		a = h->arena;
+		ASSERT (a != NULL);
+		ASSERT (a->magic == ARENA_MAGIC);
+		ASSERT (a->desc != NULL && a->desc->arena_pages > 1);
+		ASSERT (arena_to_block (a, h->idx) == b);
+		return a;
+	}
+
+	a = pg_round_down (b);
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
 	ASSERT (a->magic == ARENA_MAGIC);
 
 	/* Check that the block is properly aligned for the arena. */
+	ASSERT (a->desc == NULL || a->desc->arena_pages == 1);
 	ASSERT (a->desc == NULL
 			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
@@ -262,7 +567,23 @@ arena_to_block (struct arena *a, size_t idx) {
 	ASSERT (a != NULL);
 	ASSERT (a->magic == ARENA_MAGIC);
 	ASSERT (idx < a->desc->blocks_per_arena);
+	if (a->desc->arena_pages > 1)
+		return (struct block *) ((uint8_t *) a
+				+ MULTI_OFS
+				+ idx * (a->desc->block_size + sizeof (struct block_hdr)));
 	return (struct block *) ((uint8_t *) a
 			+ sizeof *a
 			+ idx * a->desc->block_size);
 }
+
+/* Counts a request for SIZE bytes in the size histogram. */
+static void
+hist_record (size_t size) {
+	int bucket = 0;
+
+	if (size > 16)
+		bucket = 64 - __builtin_clzll (size - 1) - 4;
+	if (bucket >= HIST_CNT)
+		bucket = HIST_CNT - 1;
+	__atomic_fetch_add (&size_hist[bucket], 1, __ATOMIC_RELAXED);
+}
@@ -2,14 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,13 +25,63 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free memory is kept as
+   blocks of 2**ORDER pages, each aligned, relative to the pool
+   base, to its own size, on one free list per order.  A request
+   for N pages takes the smallest free block of at least N pages,
+   splitting larger blocks in halves as needed, and gives back
+   the pages beyond N.  A freed block merges with its "buddy",
+   the other half of the block it was split from, for as long as
+   the buddy is free too.  Both take O(log n) steps instead of a
+   scan of the whole pool.
+
+   The free lists run through the first bytes of the free blocks
+   themselves.  order_map[] records the order of each free block
+   at the index of its first page, so that a buddy can be checked
+   in O(1).  used_map still tracks every page, to catch double
+   frees.
+
+   Pages are freed by the scheduler with interrupts off, so the
+   pools are protected by disabling interrupts rather than by a
+   lock.  No operation holds interrupts off for long.  This
+   relies on the kernel running on a single CPU; the pools would
+   need a spinlock on more than one.
+
+   Each pool also keeps a stock of free pages that are already
+   zeroed, so that single-page PAL_ZERO requests need not clear a
+   page while the caller waits.  The idle thread tops the stock
+   up with palloc_zero_refill(): once it drops below ZERO_LOW
+   pages, the idle thread zeroes pages until it holds ZERO_HIGH.
+   The zeroed pages are linked through their first bytes, which
+   are cleared again when a page is handed out.  Other requests
+   dip into the stock only when the buddy lists run dry. */
+
+/* Watermarks for the stock of zeroed pages in each pool. */
+#define ZERO_LOW 8
+#define ZERO_HIGH 32
+
+/* Number of block orders. */
+#define ORDER_CNT PALLOC_ORDER_CNT
+
+/* order_map[] value for a page that does not start a free
+   block. */
+#define ORDER_NONE 0xff
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Number of pages in pool. */
+	uint8_t *order_map;             /* Order of free block at each page. */
+	struct list free_lists[ORDER_CNT]; /* Free blocks of each order. */
+
+	struct list zeroed;             /* Free pages already zeroed. */
+	size_t zeroed_cnt;              /* Number of pages in `zeroed'. */
+	bool refilling;                 /* Topping up to ZERO_HIGH? */
+	long long zero_hits;            /* PAL_ZERO requests served zeroed. */
+	long long zero_misses;          /* PAL_ZERO requests that had to zero. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +93,16 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void *pool_alloc (struct pool *, size_t page_cnt);
+static void pool_free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void pool_claim_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void pool_free_block (struct pool *, size_t page_idx, int order);
+static int page_cnt_order (size_t page_cnt);
+static void print_pool_stats (const char *name, struct pool *);
+static void get_free_blocks (struct pool *, size_t free_blocks[ORDER_CNT]);
+static void *zeroed_get (struct pool *);
+static void zeroed_drain (struct pool *);
+static bool zeroed_refill (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -223,12 +284,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,19 +323,32 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	enum intr_level old_level;
+	bool zeroed = false;
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	old_level = intr_disable ();
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = zeroed_get (pool);
+		zeroed = pages != NULL;
+		if (zeroed)
+			pool->zero_hits++;
+		else
+			pool->zero_misses++;
+	}
+	if (!zeroed) {
+		pages = pool_alloc (pool, page_cnt);
+		if (pages == NULL && page_cnt == 1)
+			pages = zeroed_get (pool);
+		else if (pages == NULL && pool->zeroed_cnt != 0) {
+			zeroed_drain (pool);
+			pages = pool_alloc (pool, page_cnt);
+		}
+	}
+	intr_set_level (old_level);
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
@@ -299,6 +373,7 @@ palloc_get_page (enum palloc_flags flags) {
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
+	enum intr_level old_level;
 	struct pool *pool;
 	size_t page_idx;
 
@@ -318,8 +393,10 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	old_level = intr_disable ();
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_free_range (pool, page_idx, page_cnt);
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +405,328 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Tries to grow the PAGE_CNT pages at PAGES, which must have
+   come from palloc_get_multiple(), to NEW_CNT pages without
+   moving them, by taking the pages that follow.  Returns true if
+   successful, or false, changing nothing, if any of those pages
+   is in use or past the end of the pool.  The new pages are not
+   zeroed. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt) {
+	enum intr_level old_level;
+	struct pool *pool;
+	size_t page_idx;
+	bool success;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (new_cnt >= page_cnt);
+
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+	new_cnt -= page_cnt;
+
+	old_level = intr_disable ();
+	success = page_idx + new_cnt <= pool->page_cnt
+		&& !bitmap_contains (pool->used_map, page_idx, new_cnt, true);
+	if (success)
+		pool_claim_range (pool, page_idx, new_cnt);
+	intr_set_level (old_level);
+
+	return success;
+}
+
+/* Called by the idle thread, with interrupts on, to add a zeroed
+   page to a pool whose stock of them is low.  Returns true if it
+   zeroed a page, false if the stocks are full or no page is
+   free. */
+bool
+palloc_zero_refill (void) {
+	return zeroed_refill (&kernel_pool) || zeroed_refill (&user_pool);
+}
+
+/* Stores the number of single-page PAL_ZERO requests to the pool
+   that PAL_USER in FLAGS selects that were served from its stock
+   of zeroed pages in *HITS, and those that were not in
+   *MISSES. */
+void
+palloc_zero_stats (enum palloc_flags flags,
+		long long *hits, long long *misses) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+	*hits = pool->zero_hits;
+	*misses = pool->zero_misses;
+}
+
+/* Prints the number of free pages in each pool, by order. */
+void
+palloc_print_stats (void) {
+	print_pool_stats ("kernel", &kernel_pool);
+	print_pool_stats ("user", &user_pool);
+}
+
+/* Stores in FREE_BLOCKS[K] the number of free blocks of 2**K
+   pages in the pool that PAL_USER in FLAGS selects. */
+void
+palloc_get_free_blocks (enum palloc_flags flags,
+		size_t free_blocks[PALLOC_ORDER_CNT]) {
+	get_free_blocks (flags & PAL_USER ? &user_pool : &kernel_pool, free_blocks);
+}
+
+/* Stores in FREE_BLOCKS[K] the number of free blocks of 2**K
+   pages in POOL. */
+static void
+get_free_blocks (struct pool *pool, size_t free_blocks[ORDER_CNT]) {
+	enum intr_level old_level;
+	int order;
+
+	old_level = intr_disable ();
+	for (order = 0; order < ORDER_CNT; order++)
+		free_blocks[order] = list_size (&pool->free_lists[order]);
+	intr_set_level (old_level);
+}
+
+/* Prints the free pages of POOL, named NAME, by order. */
+static void
+print_pool_stats (const char *name, struct pool *pool) {
+	size_t order_cnt[ORDER_CNT];
+	size_t free_pages = 0;
+	int order;
+
+	get_free_blocks (pool, order_cnt);
+	for (order = 0; order < ORDER_CNT; order++)
+		free_pages += order_cnt[order] << order;
+
+	printf ("Palloc: %s pool: %zu of %zu pages free, %zu more zeroed\n",
+			name, free_pages, pool->page_cnt, pool->zeroed_cnt);
+	for (order = 0; order < ORDER_CNT; order++)
+		if (order_cnt[order] != 0)
+			printf ("  order %2d (%6zu pages): %zu free blocks\n",
+					order, (size_t) 1 << order, order_cnt[order]);
+	printf ("Palloc: %s pool: %lld zeroed page hits, %lld misses\n",
+			name, pool->zero_hits, pool->zero_misses);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's used_map and order_map at its base.
+     Calculate the space needed for them and subtract it from
+     the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t om_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	int order;
 
-	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->order_map = *bm_base + bm_pages;
+	for (order = 0; order < ORDER_CNT; order++)
+		list_init (&p->free_lists[order]);
+	list_init (&p->zeroed);
+	p->refilling = true;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->order_map, ORDER_NONE, pgcnt);
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages + om_pages;
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages,
+   or ORDER_CNT if there is none. */
+static int
+page_cnt_order (size_t page_cnt) {
+	int order = 0;
+
+	while (order < ORDER_CNT && ((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Returns the free list element stored in page PAGE_IDX of
+   POOL. */
+static struct list_elem *
+block_elem (struct pool *pool, size_t page_idx) {
+	return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the page that holds ELEM in POOL. */
+static size_t
+elem_page_idx (struct pool *pool, struct list_elem *elem) {
+	return ((uint8_t *) elem - pool->base) / PGSIZE;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   first, or returns a null pointer if no free block is big
+   enough.  Interrupts must be off. */
+static void *
+pool_alloc (struct pool *pool, size_t page_cnt) {
+	int want = page_cnt_order (page_cnt);
+	size_t page_idx;
+	int order;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (page_cnt == 0)
+		return NULL;
+	for (order = want; order < ORDER_CNT; order++)
+		if (!list_empty (&pool->free_lists[order]))
+			break;
+	if (order >= ORDER_CNT)
+		return NULL;
+
+	page_idx = elem_page_idx (pool, list_pop_front (&pool->free_lists[order]));
+	pool->order_map[page_idx] = ORDER_NONE;
+
+	/* Split the block down to the order wanted, freeing the upper
+	   halves, then give back the pages beyond PAGE_CNT. */
+	while (order > want) {
+		order--;
+		pool->order_map[page_idx + ((size_t) 1 << order)] = order;
+		list_push_front (&pool->free_lists[order],
+				block_elem (pool, page_idx + ((size_t) 1 << order)));
+	}
+	ASSERT (!bitmap_contains (pool->used_map, page_idx, page_cnt, true));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	pool_free_range (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+	return pool->base + PGSIZE * page_idx;
+}
+
+/* Removes and returns a page from POOL's stock of zeroed pages,
+   or returns a null pointer if the stock is empty.  Interrupts
+   must be off. */
+static void *
+zeroed_get (struct pool *pool) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (list_empty (&pool->zeroed))
+		return NULL;
+	e = list_pop_front (&pool->zeroed);
+	pool->zeroed_cnt--;
+	if (pool->zeroed_cnt < ZERO_LOW)
+		pool->refilling = true;
+	memset (e, 0, sizeof *e);
+	return e;
+}
+
+/* Gives all of POOL's zeroed pages back to the buddy lists, to
+   make room for a multi-page request.  Interrupts must be off. */
+static void
+zeroed_drain (struct pool *pool) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (!list_empty (&pool->zeroed)) {
+		void *page = list_pop_front (&pool->zeroed);
+		pool_free_range (pool, pg_no (page) - pg_no (pool->base), 1);
+	}
+	pool->zeroed_cnt = 0;
+	pool->refilling = true;
+}
+
+/* Zeroes one free page of POOL and adds it to the stock, if the
+   stock is being refilled.  Returns true if it added a page.
+   The page is zeroed with interrupts on. */
+static bool
+zeroed_refill (struct pool *pool) {
+	enum intr_level old_level;
+	uint8_t *page = NULL;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	old_level = intr_disable ();
+	if (pool->refilling) {
+		page = pool_alloc (pool, 1);
+		if (page == NULL)
+			pool->refilling = false;
+	}
+	intr_set_level (old_level);
+	if (page == NULL)
+		return false;
+
+	memset (page, 0, PGSIZE);
+
+	old_level = intr_disable ();
+	list_push_front (&pool->zeroed, (struct list_elem *) page);
+	if (++pool->zeroed_cnt >= ZERO_HIGH)
+		pool->refilling = false;
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Frees the PAGE_CNT pages of POOL starting at PAGE_IDX, as the
+   largest aligned blocks that they can be divided into.
+   Interrupts must be off, or the pool not yet in use. */
+static void
+pool_free_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	while (page_idx < end) {
+		int order = 0;
+
+		while (order + 1 < ORDER_CNT
+				&& page_idx % ((size_t) 1 << (order + 1)) == 0
+				&& page_idx + ((size_t) 1 << (order + 1)) <= end)
+			order++;
+		pool_free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+	}
+}
+
+/* Marks the PAGE_CNT free pages of POOL starting at PAGE_IDX as
+   in use, taking them out of the free blocks that hold them and
+   freeing whatever those blocks hold beyond the range.  The page
+   before PAGE_IDX must be in use, so that a free block starts at
+   PAGE_IDX. */
+static void
+pool_claim_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+
+	while (page_idx < end) {
+		int order = pool->order_map[page_idx];
+		size_t block_end;
+
+		ASSERT (order != ORDER_NONE);
+		block_end = page_idx + ((size_t) 1 << order);
+		list_remove (block_elem (pool, page_idx));
+		pool->order_map[page_idx] = ORDER_NONE;
+		if (block_end > end) {
+			pool_free_range (pool, end, block_end - end);
+			block_end = end;
+		}
+		bitmap_set_multiple (pool->used_map, page_idx, block_end - page_idx, true);
+		page_idx = block_end;
+	}
+}
+
+/* Frees the block of 2**ORDER pages of POOL at PAGE_IDX, merging
+   it with its buddy, and the result with its buddy, and so on,
+   as long as the buddy is free. */
+static void
+pool_free_block (struct pool *pool, size_t page_idx, int order) {
+	while (order + 1 < ORDER_CNT) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy + ((size_t) 1 << order) > pool->page_cnt
+				|| pool->order_map[buddy] != order)
+			break;
+		list_remove (block_elem (pool, buddy));
+		pool->order_map[buddy] = ORDER_NONE;
+		page_idx &= ~((size_t) 1 << order);
+		order++;
+	}
+	pool->order_map[page_idx] = order;
+	list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,35 @@
+#include "threads/sched_trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+#ifdef SCHED_TRACE
+/* The ring buffer.  sched_trace_head counts every event ever
+   recorded; the newest one is at (sched_trace_head - 1) modulo
+   SCHED_TRACE_SIZE. */
+struct sched_trace_rec sched_trace_buf[SCHED_TRACE_SIZE];
+uint64_t sched_trace_head;
+
+/* Prints the events in the ring buffer to the console, oldest
+   first, one per line.  Recording is paused meanwhile, so the
+   dump is consistent.  May be called at any time, not just at
+   shutdown. */
+void
+sched_trace_dump (void) {
+	enum intr_level old_level = intr_disable ();
+	uint64_t head = sched_trace_head;
+	uint64_t first = head > SCHED_TRACE_SIZE ? head - SCHED_TRACE_SIZE : 0;
+	uint64_t i;
+
+	printf ("sched-trace: begin %"PRIu64" events, %"PRIu64" lost\n",
+			head - first, first);
+	for (i = first; i < head; i++) {
+		struct sched_trace_rec *r = &sched_trace_buf[i & (SCHED_TRACE_SIZE - 1)];
+		printf ("sched-trace: %"PRIu64" %d %u %u %u %u\n",
+				r->tsc, r->tid, r->event, r->old_state, r->new_state,
+				r->priority);
+	}
+	printf ("sched-trace: end\n");
+	intr_set_level (old_level);
+}
+#endif
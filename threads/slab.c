@@ -0,0 +1,320 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   Each slab is one page: a struct slab header, then a stack of
+   the indexes of its free objects, then the objects themselves,
+   each aligned as the cache asks.  A cache keeps its slabs on
+   three lists: partial slabs, which have some objects free, full
+   slabs, which have none, and at most one empty slab, kept so
+   that a cache whose last object comes and goes does not take a
+   page from palloc every time.  Further empty slabs go back to
+   palloc.  The slab that holds an object is found by rounding
+   the object's address down to a page boundary.
+
+   In front of the slabs, each cache keeps a stack of recently
+   freed objects.  Allocation pops the most recently freed object
+   first, which is the one most likely to still be in the CPU
+   caches, and only goes to the slabs once the stack is empty.
+   Frees go back to the slabs once it is full. */
+
+/* Objects kept on a cache's stack of freed objects. */
+#define STACK_SIZE 16
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* An object cache. */
+struct kmem_cache {
+	char name[24];              /* Name, for kmem_cache_print_stats(). */
+	struct list_elem elem;      /* Element in `caches'. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t stride;              /* Distance between objects. */
+	size_t obj_ofs;             /* Offset of first object in slab. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	kmem_ctor_func *ctor;       /* Constructor, or null. */
+
+	struct lock lock;           /* Protects the members below. */
+	struct list partial;        /* Slabs with some objects free. */
+	struct list full;           /* Slabs with no objects free. */
+	struct list empty;          /* At most one slab with all free. */
+	void *stack[STACK_SIZE];    /* Recently freed objects. */
+	size_t stack_cnt;           /* Number of objects in `stack'. */
+	size_t slab_cnt;            /* Number of slabs. */
+	size_t active_cnt;          /* Objects handed out. */
+};
+
+/* A slab: the header at the start of each slab page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of the cache's lists. */
+	size_t free_cnt;            /* Number of free objects. */
+	uint16_t free_idx[];        /* Stack of free object indexes. */
+};
+
+/* All caches, in order of creation.  Protected by disabling
+   interrupts. */
+static struct list caches;
+
+static void *slab_alloc (struct kmem_cache *);
+static void slab_free (struct kmem_cache *, void *);
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_destroy (struct kmem_cache *, struct slab *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Initializes the list of caches. */
+void
+kmem_cache_init (void) {
+	list_init (&caches);
+}
+
+/* Creates and returns a cache, named NAME, of objects of SIZE
+   bytes aligned on ALIGN-byte boundaries, where ALIGN is a power
+   of 2 or 0 for the alignment of a pointer.  CTOR, if nonnull,
+   is called on each object when its slab is created.  Returns a
+   null pointer if memory is not available.  At least one object
+   must fit in a page with the slab header. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+		kmem_ctor_func *ctor) {
+	struct kmem_cache *cache;
+	enum intr_level old_level;
+	size_t n;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+	ASSERT ((align & (align - 1)) == 0);
+
+	if (align < sizeof (void *))
+		align = sizeof (void *);
+
+	cache = malloc (sizeof *cache);
+	if (cache == NULL)
+		return NULL;
+
+	strlcpy (cache->name, name, sizeof cache->name);
+	cache->obj_size = size;
+	cache->stride = ROUND_UP (size, align);
+	cache->ctor = ctor;
+
+	/* Fit as many objects as possible after the header and its
+	   stack of indexes. */
+	for (n = PGSIZE / cache->stride; n > 0; n--) {
+		size_t ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t), align);
+		if (ofs + n * cache->stride <= PGSIZE) {
+			cache->obj_ofs = ofs;
+			break;
+		}
+	}
+	ASSERT (n > 0);
+	cache->objs_per_slab = n;
+
+	lock_init (&cache->lock);
+	list_init (&cache->partial);
+	list_init (&cache->full);
+	list_init (&cache->empty);
+	cache->stack_cnt = 0;
+	cache->slab_cnt = 0;
+	cache->active_cnt = 0;
+
+	old_level = intr_disable ();
+	list_push_back (&caches, &cache->elem);
+	intr_set_level (old_level);
+
+	return cache;
+}
+
+/* Destroys CACHE, giving all its slabs back to the page
+   allocator.  Every object must have been freed. */
+void
+kmem_cache_destroy (struct kmem_cache *cache) {
+	enum intr_level old_level;
+
+	ASSERT (cache != NULL);
+	ASSERT (cache->active_cnt == 0);
+
+	while (cache->stack_cnt > 0)
+		slab_free (cache, cache->stack[--cache->stack_cnt]);
+	ASSERT (list_empty (&cache->partial) && list_empty (&cache->full));
+	while (!list_empty (&cache->empty))
+		slab_destroy (cache, list_entry (list_front (&cache->empty),
+					struct slab, elem));
+
+	old_level = intr_disable ();
+	list_remove (&cache->elem);
+	intr_set_level (old_level);
+	free (cache);
+}
+
+/* Allocates and returns an object from CACHE, or returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *cache) {
+	void *obj;
+
+	ASSERT (cache != NULL);
+
+	lock_acquire (&cache->lock);
+	if (cache->stack_cnt > 0)
+		obj = cache->stack[--cache->stack_cnt];
+	else
+		obj = slab_alloc (cache);
+	if (obj != NULL)
+		cache->active_cnt++;
+	lock_release (&cache->lock);
+
+	return obj;
+}
+
+/* Frees OBJ, which must have come from CACHE.  A null pointer is
+   ignored. */
+void
+kmem_cache_free (struct kmem_cache *cache, void *obj) {
+	ASSERT (cache != NULL);
+
+	if (obj == NULL)
+		return;
+	ASSERT (obj_to_slab (cache, obj) != NULL);
+
+	lock_acquire (&cache->lock);
+	ASSERT (cache->active_cnt > 0);
+	cache->active_cnt--;
+	if (cache->stack_cnt < STACK_SIZE)
+		cache->stack[cache->stack_cnt++] = obj;
+	else
+		slab_free (cache, obj);
+	lock_release (&cache->lock);
+}
+
+/* Prints a line for each cache: objects in use and in all, the
+   object size, objects per slab, slabs, and bytes of the slabs
+   that no object can use. */
+void
+kmem_cache_print_stats (void) {
+	struct list_elem *e;
+	enum intr_level old_level;
+
+	printf ("Slabinfo: %-16s %7s %7s %6s %5s %6s %8s\n", "name",
+			"active", "total", "size", "per", "slabs", "overhead");
+	old_level = intr_disable ();
+	for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t total = c->slab_cnt * c->objs_per_slab;
+
+		printf ("Slabinfo: %-16s %7zu %7zu %6zu %5zu %6zu %8zu\n", c->name,
+				c->active_cnt, total, c->obj_size, c->objs_per_slab, c->slab_cnt,
+				c->slab_cnt * PGSIZE - total * c->obj_size);
+	}
+	intr_set_level (old_level);
+}
+
+/* Takes an object from CACHE's slabs, creating a slab if none
+   has a free object.  Returns a null pointer if memory is not
+   available.  CACHE's lock must be held. */
+static void *
+slab_alloc (struct kmem_cache *cache) {
+	struct slab *slab;
+	size_t idx;
+
+	if (!list_empty (&cache->partial))
+		slab = list_entry (list_front (&cache->partial), struct slab, elem);
+	else {
+		if (!list_empty (&cache->empty))
+			slab = list_entry (list_pop_front (&cache->empty), struct slab, elem);
+		else {
+			slab = slab_create (cache);
+			if (slab == NULL)
+				return NULL;
+		}
+		list_push_front (&cache->partial, &slab->elem);
+	}
+
+	idx = slab->free_idx[--slab->free_cnt];
+	if (slab->free_cnt == 0) {
+		list_remove (&slab->elem);
+		list_push_front (&cache->full, &slab->elem);
+	}
+	return (uint8_t *) slab + cache->obj_ofs + idx * cache->stride;
+}
+
+/* Gives OBJ back to its slab in CACHE.  CACHE's lock must be
+   held. */
+static void
+slab_free (struct kmem_cache *cache, void *obj) {
+	struct slab *slab = obj_to_slab (cache, obj);
+	size_t idx = ((uint8_t *) obj - (uint8_t *) slab - cache->obj_ofs)
+		/ cache->stride;
+
+	slab->free_idx[slab->free_cnt++] = idx;
+	if (slab->free_cnt == 1) {
+		list_remove (&slab->elem);
+		list_push_front (&cache->partial, &slab->elem);
+	}
+	if (slab->free_cnt == cache->objs_per_slab) {
+		if (list_empty (&cache->empty)) {
+			list_remove (&slab->elem);
+			list_push_front (&cache->empty, &slab->elem);
+		} else
+			slab_destroy (cache, slab);
+	}
+}
+
+/* Creates and returns a new slab for CACHE, with all of its
+   objects free and constructed, or returns a null pointer if
+   memory is not available.  The slab is on no list. */
+static struct slab *
+slab_create (struct kmem_cache *cache) {
+	struct slab *slab = palloc_get_page (0);
+	size_t i;
+
+	if (slab == NULL)
+		return NULL;
+
+	slab->magic = SLAB_MAGIC;
+	slab->cache = cache;
+	slab->free_cnt = cache->objs_per_slab;
+	for (i = 0; i < cache->objs_per_slab; i++) {
+		/* Hand out lower addresses first. */
+		slab->free_idx[i] = cache->objs_per_slab - 1 - i;
+		if (cache->ctor != NULL)
+			cache->ctor ((uint8_t *) slab + cache->obj_ofs + i * cache->stride);
+	}
+	cache->slab_cnt++;
+	return slab;
+}
+
+/* Removes empty SLAB from its list in CACHE and frees it. */
+static void
+slab_destroy (struct kmem_cache *cache, struct slab *slab) {
+	ASSERT (slab->free_cnt == cache->objs_per_slab);
+
+	list_remove (&slab->elem);
+	slab->magic = 0;
+	palloc_free_page (slab);
+	cache->slab_cnt--;
+}
+
+/* Returns the slab that holds OBJ, checking that it belongs to
+   CACHE and that OBJ is the start of an object. */
+static struct slab *
+obj_to_slab (struct kmem_cache *cache, void *obj) {
+	struct slab *slab = pg_round_down (obj);
+
+	ASSERT (slab->magic == SLAB_MAGIC);
+	ASSERT (slab->cache == cache);
+	ASSERT (((uint8_t *) obj - (uint8_t *) slab - cache->obj_ofs)
+			% cache->stride == 0);
+	return slab;
+}
@@ -0,0 +1,137 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <intrinsic.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* Most work items that one softirq_run() call runs.  Any left
+   over run at the end of the next interrupt, so that work that
+   keeps queueing itself cannot hold up the interrupted thread
+   forever. */
+#define SOFTIRQ_BATCH 64
+
+/* Queued work, one queue per priority. */
+static struct list work_queues[WORK_PRI_CNT];
+
+/* Statistics. */
+static long long work_cnt;      /* # of work items run. */
+static long long overflow_cnt;  /* # of times SOFTIRQ_BATCH was hit. */
+static uint64_t work_cycles;    /* TSC cycles spent running work. */
+
+/* Initializes the work queues. */
+void
+softirq_init (void) {
+	int pri;
+
+	for (pri = 0; pri < WORK_PRI_CNT; pri++)
+		list_init (&work_queues[pri]);
+}
+
+/* Initializes W to call FUNC with AUX when it runs. */
+void
+work_init (struct work *w, work_func *func, void *aux) {
+	ASSERT (w != NULL);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->queued = false;
+}
+
+/* Queues W to run at priority PRI when the current interrupt
+   returns, or when the next one does if called outside an
+   interrupt.  Returns false, and does nothing, if W is already
+   queued.  W may be queued again once it has started running.
+   May be called from an interrupt handler. */
+bool
+work_queue (struct work *w, enum work_priority pri) {
+	enum intr_level old_level;
+	bool queued;
+
+	ASSERT (w != NULL);
+	ASSERT (pri < WORK_PRI_CNT);
+
+	old_level = intr_disable ();
+	queued = !w->queued;
+	if (queued) {
+		w->queued = true;
+		list_push_back (&work_queues[pri], &w->elem);
+	}
+	intr_set_level (old_level);
+
+	return queued;
+}
+
+/* Returns true if any work is queued.  Interrupts must be
+   off. */
+bool
+softirq_pending (void) {
+	int pri;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (pri = 0; pri < WORK_PRI_CNT; pri++)
+		if (!list_empty (&work_queues[pri]))
+			return true;
+	return false;
+}
+
+/* Removes and returns the highest priority queued work item,
+   or a null pointer if none is queued. */
+static struct work *
+work_next (void) {
+	int pri;
+
+	for (pri = 0; pri < WORK_PRI_CNT; pri++)
+		if (!list_empty (&work_queues[pri])) {
+			struct work *w = list_entry (list_pop_front (&work_queues[pri]),
+					struct work, elem);
+			w->queued = false;
+			return w;
+		}
+	return NULL;
+}
+
+/* Runs queued work, highest priority first, with interrupts on
+   while each item runs.  Called by intr_handler() at the end of
+   an external interrupt that did not interrupt other work.
+   Interrupts must be off, and are off again on return. */
+void
+softirq_run (void) {
+	struct work *w;
+	int batch;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (intr_context ());
+
+	for (batch = 0; batch < SOFTIRQ_BATCH && (w = work_next ()) != NULL;
+			batch++) {
+		uint64_t start = rdtsc ();
+
+		intr_enable ();
+		w->func (w->aux);
+		intr_disable ();
+		work_cnt++;
+		work_cycles += rdtsc () - start;
+	}
+	if (batch == SOFTIRQ_BATCH && softirq_pending ())
+		overflow_cnt++;
+}
+
+/* Returns the total number of TSC cycles spent running work
+   since boot, including any interrupts taken meanwhile. */
+uint64_t
+softirq_cycles (void) {
+	enum intr_level old_level = intr_disable ();
+	uint64_t cycles = work_cycles;
+	intr_set_level (old_level);
+	return cycles;
+}
+
+/* Prints deferred work statistics. */
+void
+softirq_print_stats (void) {
+	printf ("Softirq: %lld work items run in %"PRIu64" cycles, "
+			"%lld batches cut short\n", work_cnt, work_cycles, overflow_cnt);
+}
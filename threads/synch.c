@@ -30,8 +30,52 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/sched_trace.h"
 #include "threads/thread.h"
 
+/* One waiter on a condition variable. */
+struct semaphore_elem {
+	struct pq_elem elem;                /* Element in the condition's waiters. */
+	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Thread waiting on the semaphore. */
+	struct condition *cond;             /* Condition being waited for. */
+};
+
+static bool sema_waiter_less (const struct pq_elem *,
+		const struct pq_elem *, void *aux);
+static bool cond_waiter_less (const struct pq_elem *,
+		const struct pq_elem *, void *aux);
+static void donation_propagate (struct thread *);
+static void lock_link (struct lock *, struct thread *holder);
+
+/* Fast paths.
+
+   A semaphore's value and a lock's holder are updated with
+   atomic instructions, so that sema_down(), sema_up(),
+   lock_acquire() and lock_release() need not turn interrupts
+   off, or touch any list, when nobody has to wait.  Interrupts
+   go off only to queue up as a waiter, or to wake one.
+
+   A waiter queues itself and then checks again, with interrupts
+   off, before it blocks.  sema_up() increments the value before
+   it looks for waiters.  So either the waiter sees the new
+   value, or sema_up() sees the waiter.
+
+   LOCK_CONTENDED, in the low bit of a lock's `holder', is set
+   when some thread has waited for the lock since its holder
+   acquired it.  While the bit is set, the lock is in its
+   holder's held_locks and receives donations.  Waiters set the
+   bit with interrupts off.  Threads never run while interrupts
+   are off, so the holder's compare-and-swap either failed
+   before that, or will fail. */
+#define LOCK_CONTENDED ((uintptr_t) 1)
+
+/* Returns the thread holding LOCK, or a null pointer. */
+static inline struct thread *
+lock_holder (const struct lock *lock) {
+	return (struct thread *) ((uintptr_t) lock->holder & ~LOCK_CONTENDED);
+}
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -41,23 +85,12 @@
 
    - up or "V": increment the value (and wake up one waiting
    thread, if any). */
-
-void
-lock_update_priority(struct lock * lock);
-
-static bool
-cond_order_sem_list(const struct list_elem * a, const struct list_elem * b, void * aux UNUSED);
-
-static bool
-lock_order_list(const struct list_elem * a, const struct list_elem *b,void * aux UNUSED);
-
-
 void
 sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	pq_init (&sema->waiters, sema_waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -75,14 +108,17 @@ sema_down (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
+	if (sema_try_down (sema))
+		return;
+
 	old_level = intr_disable ();
+	while (!sema_try_down (sema)) {
+		struct thread *curr = thread_current ();
 
-	
-	while (sema->value == 0) {
-		list_insert_ordered (&sema->waiters, &thread_current ()->elem,thread_order_ready_list,NULL);
+		curr->wait_sema = sema;
+		pq_push (&sema->waiters, &curr->wait_elem);
 		thread_block ();
 	}
-	sema->value--;
 	intr_set_level (old_level);
 }
 
@@ -93,22 +129,16 @@ sema_down (struct semaphore *sema) {
    This function may be called from an interrupt handler. */
 bool
 sema_try_down (struct semaphore *sema) {
-	enum intr_level old_level;
-	bool success;
+	unsigned value;
 
 	ASSERT (sema != NULL);
 
-	old_level = intr_disable ();
-	if (sema->value > 0)
-	{
-		sema->value--;
-		success = true;
-	}
-	else
-		success = false;
-	intr_set_level (old_level);
-
-	return success;
+	value = __atomic_load_n (&sema->value, __ATOMIC_RELAXED);
+	while (value > 0)
+		if (__atomic_compare_exchange_n (&sema->value, &value, value - 1,
+					false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return true;
+	return false;
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
@@ -124,28 +154,43 @@ sema_up (struct semaphore *sema) {
 
 	ASSERT (sema != NULL);
 
-	old_level = intr_disable ();
-
-	//sort the waiters list
-	//list_sort(&sema->waiters,thread_order_ready_list,NULL);
-	
-	sema->value++;
+	__atomic_fetch_add (&sema->value, 1, __ATOMIC_SEQ_CST);
+	if (pq_empty (&sema->waiters))
+		return;
 
-	if (!list_empty (&sema->waiters)){
-		t = list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem);
+	/* The woken thread runs at once if it outranks us. */
+	old_level = intr_disable ();
+	if (!pq_empty (&sema->waiters)) {
+		t = pq_entry (pq_pop (&sema->waiters), struct thread, wait_elem);
+		t->wait_sema = NULL;
+		thread_wake (t);
+	}
+	intr_set_level (old_level);
+}
 
-		thread_unblock (t);
 
-		// not waiting for any locks
-	/*	t->wait_on_lock = NULL;
+/* Moves thread T, whose priority has just changed, to its new
+   place among the waiters of the semaphore or condition variable
+   it is waiting on, if any, so that the next sema_up() or
+   cond_signal() still wakes the highest-priority waiter.
+   Interrupts must be off. */
+void
+sema_requeue (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
 
-		//thread_run(t); // run if priority is maximum*/
-	}
-		
-	intr_set_level (old_level);
+	if (t->wait_sema != NULL)
+		pq_update (&t->wait_sema->waiters, &t->wait_elem);
+	if (t->cond_waiter != NULL)
+		pq_update (&t->cond_waiter->cond->waiters, &t->cond_waiter->elem);
 }
 
+/* Orders threads by priority, for a semaphore's waiters. */
+static bool
+sema_waiter_less (const struct pq_elem *a, const struct pq_elem *b,
+		void *aux UNUSED) {
+	return pq_entry (a, struct thread, wait_elem)->priority
+		< pq_entry (b, struct thread, wait_elem)->priority;
+}
 
 static void sema_test_helper (void *sema_);
 
@@ -202,7 +247,9 @@ lock_init (struct lock *lock) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
-	sema_init (&lock->semaphore, 1);
+	sema_init (&lock->semaphore, 0);
+	pq_init (&lock->waiters, thread_priority_less, NULL);
+	lockstat_init (&lock->stat);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -215,35 +262,52 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	uint64_t wait_start = lockstat_clock ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	
-	//donate priority to the lock holder if necessary
-	struct thread * lock_holder = lock->holder;
-	struct thread * curr_thread = thread_current();
-
-	/* update the priority of the lock and insert the thread into waiting list if the 
-	lock is held, if it is updated then  */ 
-	/*if(lock_holder){
-		int curr_priority = lock->priority;
-		lock->priority = MAX(lock->priority,curr_thread->priority);
-		curr_thread->wait_on_lock = (void *) lock;
-		
-		if(!list_empty(&lock_holder->donation_list) && curr_priority < lock->priority){
-			lock_update_priority(lock);
+	if (lock_try_acquire (lock))
+		return;
+
+	old_level = intr_disable ();
+	while (!lock_try_acquire (lock)) {
+		/* Wait among LOCK's waiters, which donates our priority to
+		   its holder, and from there down the chain of locks the
+		   holder is waiting for.  The MLFQS does not donate. */
+		struct thread *holder = lock_holder (lock);
+
+		if (curr->wait_on_lock == NULL) {
+			curr->wait_on_lock = lock;
+			pq_push (&lock->waiters, &curr->donor_elem);
+		}
+		lock_link (lock, holder);
+		if (!thread_mlfqs && thread_refresh_priority (holder)) {
+			sched_trace (SCHED_EV_DONATE, holder->tid, holder->status,
+					holder->status, holder->priority);
+			donation_propagate (holder);
 		}
-	}*/
-	
-	sema_down (&lock->semaphore);
-	lock->holder = thread_current ();
-	/*
-	lock->priority = lock->holder_priority = lock_holder->priority;
-	list_insert_ordered(&lock_holder->donation_list,&lock->elem,lock_order_list,NULL);*/
-	return;
-	
-}  
+		sema_down (&lock->semaphore);
+	}
+
+	if (curr->wait_on_lock != NULL) {
+		pq_remove (&lock->waiters, &curr->donor_elem);
+		curr->wait_on_lock = NULL;
+		lockstat_contended (&lock->stat, wait_start,
+				__builtin_return_address (0));
+	}
+
+	/* Threads still waiting donate to us now. */
+	if (!pq_empty (&lock->waiters)) {
+		lock_link (lock, curr);
+		if (!thread_mlfqs)
+			thread_refresh_priority (curr);
+	}
+	intr_set_level (old_level);
+}
 
 /* Tries to acquires LOCK and returns true if successful or false
    on failure.  The lock must not already be held by the current
@@ -253,15 +317,16 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
-	bool success;
+	struct thread *expected = NULL;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	success = sema_try_down (&lock->semaphore);
-	if (success)
-		lock->holder = thread_current ();
-	return success;
+	if (!__atomic_compare_exchange_n (&lock->holder, &expected,
+				thread_current (), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+	lockstat_acquired (&lock->stat);
+	return true;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
@@ -272,22 +337,91 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	struct thread *expected = curr;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
-	
-	struct thread * lock_holder = lock->holder;
-	//struct list * donation_list_ptr = &lock_holder->donation_list;
 
-	//ASSERT(!list_empty(donation_list_ptr));
+	lockstat_released (&lock->stat);
+	if (__atomic_compare_exchange_n (&lock->holder, &expected, NULL,
+				false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		return;
+
+	/* Give back whatever LOCK's waiters donated to us.  They keep
+	   waiting on LOCK, and donate to whoever acquires it next. */
+	old_level = intr_disable ();
+	pq_remove (&curr->held_locks, &lock->elem);
+	__atomic_store_n (&lock->holder, NULL, __ATOMIC_RELEASE);
+	if (!thread_mlfqs)
+		thread_refresh_priority (curr);
+	if (!pq_empty (&lock->semaphore.waiters))
+		sema_up (&lock->semaphore);
+	intr_set_level (old_level);
+}
+
+/* Makes sure that LOCK, held by HOLDER, is among HOLDER's
+   held_locks, so that LOCK's waiters donate to HOLDER, and
+   repositions it there after a change to its waiters.
+   Interrupts must be off. */
+static void
+lock_link (struct lock *lock, struct thread *holder) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (lock_holder (lock) == holder);
+
+	if ((uintptr_t) lock->holder & LOCK_CONTENDED)
+		pq_update (&holder->held_locks, &lock->elem);
+	else {
+		lock->holder = (struct thread *) ((uintptr_t) holder | LOCK_CONTENDED);
+		pq_push (&holder->held_locks, &lock->elem);
+	}
+}
 
-	/* removes the lock from donation and updates the priority */
-	/*list_remove(&lock->elem);
-	lock_update_priority(lock);
+/* Returns the priority that LOCK donates to its holder: that of
+   its highest-priority waiter, or PRI_MIN - 1 if nobody waits. */
+int
+lock_priority (const struct lock *lock) {
+	struct pq_elem *top = pq_top (&lock->waiters);
 
-	lock->priority  = lock->holder_priority =  0;
-	lock->holder = NULL;*/
-	lock->holder = NULL;
-	sema_up(&lock->semaphore);
+	if (top == NULL)
+		return PRI_MIN - 1;
+	return pq_entry (top, struct thread, donor_elem)->priority;
+}
+
+/* Orders locks by the priority they donate, for a thread's
+   held_locks. */
+bool
+lock_priority_less (const struct pq_elem *a, const struct pq_elem *b,
+		void *aux UNUSED) {
+	return lock_priority (pq_entry (a, struct lock, elem))
+		< lock_priority (pq_entry (b, struct lock, elem));
+}
+
+/* Passes a change in the priority of thread T on down the chain
+   of donations: repositions T among the waiters of the lock it
+   waits for, repositions that lock among its holder's locks,
+   recomputes the holder's priority, and repeats from the holder.
+   Stops as soon as a priority does not change, so only the
+   affected threads are touched. */
+static void
+donation_propagate (struct thread *t) {
+	struct lock *lock;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while ((lock = t->wait_on_lock) != NULL) {
+		struct thread *holder = lock_holder (lock);
+
+		pq_update (&lock->waiters, &t->donor_elem);
+		if (holder == NULL)
+			break;
+		lock_link (lock, holder);
+		if (!thread_refresh_priority (holder))
+			break;
+		t = holder;
+	}
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -297,15 +431,9 @@ bool
 lock_held_by_current_thread (const struct lock *lock) {
 	ASSERT (lock != NULL);
 
-	return lock->holder == thread_current ();
+	return lock_holder (lock) == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -313,7 +441,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	pq_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -336,74 +464,10 @@ cond_init (struct condition *cond) {
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
-
-static bool
-cond_order_sem_list(const struct list_elem * a, const struct list_elem * b, void * aux UNUSED){
-	struct semaphore_elem * sem_elem_1 = list_entry(a,struct semaphore_elem,elem);
-	struct semaphore_elem * sem_elem_2 = list_entry(b,struct semaphore_elem,elem);
-
-	return *(sem_elem_1->semaphore.priority) > *(sem_elem_2->semaphore.priority);
-}
-
-static bool
-lock_order_list(const struct list_elem * a, const struct list_elem *b,void * aux UNUSED){
-	struct lock * lock_1 = list_entry(a,struct lock,elem);
-	struct lock * lock_2 = list_entry(b,struct lock,elem);
-
-	return lock_1->priority > lock_2->priority;
-}
-
-
-/* Finds the priority of the lock and updates the field */
-void
-lock_update_priority(struct lock * lock){
-	struct thread * holder = lock->holder;
-	struct list * donation_list_ptr = &holder->donation_list;
-
-	struct list_elem * e;
-	int max_priority = lock->holder_priority;
-
-	list_sort(&holder->donation_list,lock_order_list,NULL);
-	if(!list_empty(donation_list_ptr)){
-		e = list_front(donation_list_ptr);
-		max_priority = list_entry(e,struct lock,elem)->priority;
-	}
-
-	holder->priority = max_priority;
-
-	int priority = max_priority;
-	int tmp;
-	struct lock * lock_tmp;
-
-	
-	// nested donation
-	while(true){
-		 if(holder->wait_on_lock){
-			 lock_tmp = ((struct lock *) holder->wait_on_lock);
-			 holder = lock_tmp->holder;
-			 tmp = holder->priority;
-			 
-			 holder->priority = MAX(priority,holder->priority);
-			 lock_tmp->priority = holder->priority;
-			 
-			 // if any change then continue
-			 if(holder->priority > tmp){
-				 continue;
-			 }
-			 else{
-				 break;
-			 }
-		 }
-		 else{
-			 break;
-		 }
-
-	}
-}
-
 void
 cond_wait (struct condition *cond, struct lock *lock) {
 	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -411,12 +475,13 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
+	waiter.thread = thread_current ();
+	waiter.cond = cond;
 
-	// semaphore's priority is the current's thread priority
-  /* waiter.semaphore.priority = &thread_current()->priority;
-	list_insert_ordered(&cond->waiters, &waiter.elem,cond_order_sem_list,NULL);*/
-
-	list_push_back (&cond->waiters, &waiter.elem);// remove this
+	old_level = intr_disable ();
+	waiter.thread->cond_waiter = &waiter;
+	pq_push (&cond->waiters, &waiter.elem);
+	intr_set_level (old_level);
 
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
@@ -432,16 +497,31 @@ cond_wait (struct condition *cond, struct lock *lock) {
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	enum intr_level old_level;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	//sort the waiters list
-	// list_sort(&cond->waiters,cond_order_sem_list,NULL);
-	if (!list_empty (&cond->waiters))
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	old_level = intr_disable ();
+	if (!pq_empty (&cond->waiters)) {
+		struct semaphore_elem *waiter = pq_entry (pq_pop (&cond->waiters),
+				struct semaphore_elem, elem);
+
+		waiter->thread->cond_waiter = NULL;
+		sema_up (&waiter->semaphore);
+	}
+	intr_set_level (old_level);
+}
+
+/* Orders condition variable waiters by the priority of the
+   waiting thread. */
+static bool
+cond_waiter_less (const struct pq_elem *a, const struct pq_elem *b,
+		void *aux UNUSED) {
+	return pq_entry (a, struct semaphore_elem, elem)->thread->priority
+		< pq_entry (b, struct semaphore_elem, elem)->thread->priority;
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -455,6 +535,276 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!pq_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK as unheld.
+
+   A readers-writer lock lets any number of readers hold it
+   together, or a single writer alone.  Writers have preference:
+   once a writer is waiting, new readers wait too, so a steady
+   stream of readers cannot starve writers.  A writer holds an
+   ordinary lock, `writer', for as long as it writes or waits for
+   the readers to leave, so the threads that wait for it donate
+   their priority to it.  Readers are not tracked individually
+   and do not receive donations.
+
+   Like locks, readers-writer locks are not recursive: a thread
+   that holds RWLOCK in either mode must not acquire it again. */
+void
+rwlock_init (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	lock_init (&rwlock->writer);
+	rwlock->readers = 0;
+	rwlock->draining = false;
+	sema_init (&rwlock->drained, 0);
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds it
+   or waits for it if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rwlock) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!lock_held_by_current_thread (&rwlock->writer));
+
+	/* With no writer around, just count ourselves in. */
+	old_level = intr_disable ();
+	if (lock_holder (&rwlock->writer) == NULL && pq_empty (&rwlock->writer.waiters)) {
+		rwlock->readers++;
+		intr_set_level (old_level);
+		return;
+	}
+	intr_set_level (old_level);
+
+	/* Otherwise queue up behind the writers. */
+	lock_acquire (&rwlock->writer);
+	rwlock->readers++;
+	lock_release (&rwlock->writer);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading. */
+void
+rwlock_read_release (struct rwlock *rwlock) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (rwlock->readers > 0);
+
+	old_level = intr_disable ();
+	if (--rwlock->readers == 0 && rwlock->draining) {
+		rwlock->draining = false;
+		sema_up (&rwlock->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it in either mode if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rwlock) {
+	enum intr_level old_level;
+
+	ASSERT (rwlock != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rwlock->writer);
+
+	/* New readers now wait for us.  Wait for the old ones to
+	   leave. */
+	old_level = intr_disable ();
+	if (rwlock->readers > 0) {
+		rwlock->draining = true;
+		sema_down (&rwlock->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void
+rwlock_write_release (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+	ASSERT (rwlock->readers == 0);
+
+	lock_release (&rwlock->writer);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	return lock_held_by_current_thread (&rwlock->writer);
+}
+
+/* State shared by rwlock_self_test() and its helper. */
+struct rwlock_test {
+	struct rwlock rwlock;
+	struct semaphore reading;           /* Helper holds a read lock. */
+	struct semaphore done;              /* Helper is finished. */
+	bool written;                       /* Helper has written. */
+};
+
+static void rwlock_test_helper (void *);
+
+/* Self-test for readers-writer locks.  A second thread acquires
+   the lock for reading while we hold it for reading, then has to
+   wait to write until we let go. */
+void
+rwlock_self_test (void) {
+	struct rwlock_test t;
+
+	printf ("Testing rwlocks...");
+	rwlock_init (&t.rwlock);
+	sema_init (&t.reading, 0);
+	sema_init (&t.done, 0);
+	t.written = false;
+
+	rwlock_read_acquire (&t.rwlock);
+	thread_create ("rwlock-test", thread_get_priority (),
+			rwlock_test_helper, &t);
+	sema_down (&t.reading);
+	ASSERT (!t.written);
+	rwlock_read_release (&t.rwlock);
+
+	sema_down (&t.done);
+	ASSERT (t.written);
+	rwlock_write_acquire (&t.rwlock);
+	rwlock_write_release (&t.rwlock);
+	printf ("done.\n");
+}
+
+/* Thread function used by rwlock_self_test(). */
+static void
+rwlock_test_helper (void *t_) {
+	struct rwlock_test *t = t_;
+
+	rwlock_read_acquire (&t->rwlock);
+	sema_up (&t->reading);
+	rwlock_read_release (&t->rwlock);
+
+	rwlock_write_acquire (&t->rwlock);
+	ASSERT (rwlock_write_held_by_current_thread (&t->rwlock));
+	t->written = true;
+	rwlock_write_release (&t->rwlock);
+	sema_up (&t->done);
+}
+
+/* Initializes SEQLOCK. */
+void
+seqlock_init (struct seqlock *seqlock) {
+	ASSERT (seqlock != NULL);
+
+	seqlock->seq = 0;
+}
+
+/* Begins a read of the record that SEQLOCK protects.  Returns a
+   sequence number to pass to seqlock_read_retry() once the
+   record has been copied. */
+unsigned
+seqlock_read_begin (const struct seqlock *seqlock) {
+	unsigned seq = *(volatile const unsigned *) &seqlock->seq;
+
+	barrier ();
+	return seq;
+}
+
+/* Returns true if the record that SEQLOCK protects may have
+   changed, or been in the middle of a change, since
+   seqlock_read_begin() returned SEQ.  If so, the reader must
+   start over. */
+bool
+seqlock_read_retry (const struct seqlock *seqlock, unsigned seq) {
+	barrier ();
+	return (seq & 1) != 0
+		|| *(volatile const unsigned *) &seqlock->seq != seq;
+}
+
+/* Begins a write of the record that SEQLOCK protects.
+   Interrupts must be off until seqlock_write_end(), so that the
+   write cannot be interleaved with another one. */
+void
+seqlock_write_begin (struct seqlock *seqlock) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT ((seqlock->seq & 1) == 0);
+
+	seqlock->seq++;
+	barrier ();
+}
+
+/* Ends a write begun by seqlock_write_begin(). */
+void
+seqlock_write_end (struct seqlock *seqlock) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT ((seqlock->seq & 1) != 0);
+
+	barrier ();
+	seqlock->seq++;
+}
+
+/* A record protected by a seqlock, for seqlock_self_test(). */
+struct seqlock_test {
+	struct seqlock seqlock;
+	int a, b;                           /* Always equal, when consistent. */
+};
+
+#define SEQLOCK_TEST_WRITES 10
+
+static void seqlock_test_helper (void *);
+
+/* Self-test for sequence locks.  A second thread updates the
+   record every time we yield in the middle of reading it, so we
+   must retry until it stops writing. */
+void
+seqlock_self_test (void) {
+	struct seqlock_test t;
+	unsigned seq;
+	int a, b, tries = 0;
+
+	printf ("Testing seqlocks...");
+	seqlock_init (&t.seqlock);
+	t.a = t.b = 0;
+	thread_create ("seqlock-test", thread_get_priority (),
+			seqlock_test_helper, &t);
+	do {
+		seq = seqlock_read_begin (&t.seqlock);
+		a = t.a;
+		thread_yield ();
+		b = t.b;
+		tries++;
+	} while (seqlock_read_retry (&t.seqlock, seq));
+	ASSERT (a == b && a == SEQLOCK_TEST_WRITES);
+	ASSERT (tries > 1);
+	printf ("done.\n");
+}
+
+/* Thread function used by seqlock_self_test(). */
+static void
+seqlock_test_helper (void *t_) {
+	struct seqlock_test *t = t_;
+	int i;
+
+	for (i = 0; i < SEQLOCK_TEST_WRITES; i++) {
+		enum intr_level old_level = intr_disable ();
+
+		seqlock_write_begin (&t->seqlock);
+		t->a++;
+		t->b++;
+		seqlock_write_end (&t->seqlock);
+		intr_set_level (old_level);
+		thread_yield ();
+	}
+}
@@ -5,5 +5,11 @@ threads_SRC += threads/intr-stubs.S	# Interrupt stubs.
 threads_SRC += threads/synch.c		# Synchronization.
 threads_SRC += threads/palloc.c		# Page allocator.
 threads_SRC += threads/malloc.c		# Subpage allocator.
+threads_SRC += threads/slab.c		# Object-cache allocator.
 threads_SRC += threads/start.S		# Startup code.
+threads_SRC += threads/switch.S		# Thread switch routine.
 threads_SRC += threads/mmu.c		    # Memory management unit related things.
+threads_SRC += threads/sched_trace.c	# Scheduler event tracing.
+threads_SRC += threads/lockstat.c	# Lock contention statistics.
+threads_SRC += threads/softirq.c	# Deferred interrupt work.
+threads_SRC += threads/futex.c		# Futex wait queues.
@@ -8,8 +8,12 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/sched_trace.h"
+#include "threads/softirq.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #include "fixed_point.h"
 #ifdef USERPROG
@@ -27,15 +31,51 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* List of all threads in the system */
-static struct list thread_list;
-
-
-static struct list sleep_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO list
+   per priority level, and bit P of ready_mask is set exactly when
+   ready_queues[P] is nonempty, so enqueueing is O(1) and finding
+   the highest-priority ready thread is a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+
+/* Completely fair scheduler.
+
+   If thread_cfs is set, ready threads wait in cfs_tree, a
+   red-black tree ordered by virtual runtime, instead of in
+   ready_queues[], and priorities are ignored.  A thread's
+   vruntime grows by the TSC cycles it runs, scaled by
+   CFS_NICE_0_WEIGHT over the weight of its nice value, so
+   threads with lower nice values age more slowly and get more
+   of the CPU.  The ready thread with the smallest vruntime runs
+   next.
+
+   Instead of a fixed TIME_SLICE, the running thread gets its
+   weighted share of CFS_LATENCY ticks, the period in which every
+   ready thread should run once, but at least CFS_MIN_GRANULARITY
+   ticks. */
+#define CFS_LATENCY 8               /* Target latency, in ticks. */
+#define CFS_MIN_GRANULARITY 1       /* Shortest slice, in ticks. */
+#define CFS_NICE_0_WEIGHT 1024      /* Weight of nice value 0. */
+bool thread_cfs;
+static struct rb_tree cfs_tree;     /* Ready threads by vruntime. */
+static uint64_t cfs_min_vruntime;   /* Nondecreasing floor of vruntimes. */
+static uint64_t cfs_load;           /* Sum of weights in cfs_tree. */
+static uint64_t cfs_exec_start;     /* TSC of the last charge. */
+
+/* Weight of each nice value from -20 to 20.  Each step is
+   about 1.25x, so one nice level is about 10% of the CPU. */
+static const uint32_t cfs_nice_weight[] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548, 7620, 6100, 4904, 3906,
+	/*  -5 */ 3121, 2501, 1991, 1586, 1277,
+	/*   0 */ 1024, 820, 655, 526, 423,
+	/*   5 */ 335, 272, 215, 172, 137,
+	/*  10 */ 110, 87, 70, 56, 45,
+	/*  15 */ 36, 29, 23, 18, 15,
+	/*  20 */ 12,
+};
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -43,31 +83,70 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Pages of dead threads, kept for reuse by thread_create() so
+   that short-lived threads need not go through palloc, nor zero
+   a whole page, every time.  Linked through struct thread's
+   `elem'.  Protected by disabling interrupts. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;     /* # of pages reused. */
+static long long thread_cache_misses;   /* # of pages from palloc. */
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long handoff_cnt;   /* # of direct switches in thread_wake(). */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;  
  /* # of timer ticks since last yield. */
 
-unsigned global_tick = UINT32_MAX;
-
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, print each thread's statistics when it exits. */
+bool thread_exit_stats;
+
 static int load_avg;
+static struct seqlock load_avg_seqlock;     /* Lets readers skip intr_disable(). */
+
+/* MLFQS bookkeeping.
+
+   Once per second, every thread's recent_cpu decays by a factor
+   that depends on load_avg at that second.  Instead of walking
+   all threads each second, each thread records the second
+   (epoch) up to which its recent_cpu is current, and the decay
+   factors of the last MLFQS_HISTORY seconds are kept in
+   decay_history[].  A thread's pending decays are applied only
+   when it is next examined: when it becomes ready, while it
+   runs, and every 4 ticks while it sits in the ready queue.
+   The 4-tick pass over the ready threads is deferred work,
+   mlfqs_work, which lets interrupts in between threads.
+
+   Blocked threads are parked in mlfqs_parked[], by epoch, so
+   that none falls further behind than the history reaches and
+   every decay applied is the exact one for its second.  At the
+   start of epoch E, just before its factor overwrites that of
+   epoch E - MLFQS_HISTORY, the threads parked since that epoch
+   are brought up to E - 1 and re-parked.  So a thread blocked
+   for less than MLFQS_HISTORY seconds costs the timer interrupt
+   nothing, and one blocked longer costs it MLFQS_HISTORY - 1
+   decays once every MLFQS_HISTORY - 1 seconds. */
+#define MLFQS_HISTORY 256
+static int64_t mlfqs_epoch;                 /* # of load_avg updates so far. */
+static int decay_history[MLFQS_HISTORY];    /* Factor for epoch E at E % size. */
+static struct list mlfqs_parked[MLFQS_HISTORY]; /* Blocked threads, by epoch % size. */
+static size_t ready_cnt;                    /* # of threads in ready queues. */
+static struct work mlfqs_work;              /* Runs mlfqs_refresh_ready(). */
 
 bool thread_started = false;
 
@@ -78,7 +157,27 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
+static void schedule_to (struct thread *next);
 static tid_t allocate_tid (void);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static void ready_queue_push (struct thread *);
+static void ready_queue_push_front (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
+static struct thread *ready_queue_find (tid_t);
+static void account_ready_wait (struct thread *);
+static bool cfs_less (const struct rb_node *, const struct rb_node *,
+		void *aux);
+static uint32_t cfs_weight (const struct thread *);
+static void cfs_charge (struct thread *);
+static bool cfs_slice_expired (struct thread *);
+static void print_thread_stats (struct thread *);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_decay_recent_cpu (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_park (struct thread *);
+static work_func mlfqs_refresh_ready;
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -123,10 +222,15 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init(&thread_list);
-	list_init(&sleep_list);
+	list_init (&thread_cache);
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&ready_queues[pri]);
+	ready_mask = 0;
+	for (int i = 0; i < MLFQS_HISTORY; i++)
+		list_init (&mlfqs_parked[i]);
+	work_init (&mlfqs_work, mlfqs_refresh_ready, NULL);
+	rb_init (&cfs_tree, cfs_less, NULL);
+	cfs_exec_start = rdtsc ();
 	list_init (&destruction_req);
 
 	/* Set up a thread structure for the running thread. */
@@ -145,6 +249,7 @@ thread_start (void) {
 	sema_init (&idle_started, 0);
 	thread_create ("idle", PRI_MIN, idle, &idle_started);
 
+	seqlock_init (&load_avg_seqlock);
 	load_avg = 0;
 	/* Start preemptive thread scheduling. */
 	intr_enable ();
@@ -154,15 +259,6 @@ thread_start (void) {
 	thread_started = true;
 }
 
-struct list_elem * in_sleep_thread_remove(struct list_elem * elem){
-	ASSERT(elem != NULL && !list_empty(&sleep_list));
-	ASSERT (intr_get_level () == INTR_OFF);
-	
-	list_pop_front(&sleep_list);
-	return list_empty(&sleep_list)?NULL:list_front(&sleep_list);
-	
-}
-
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void
@@ -173,43 +269,90 @@ thread_tick (void) {
 	if (t == idle_thread)
 		idle_ticks++;
 #ifdef USERPROG
-	else if (t->pml4 != NULL)
+	else if (t->pml4 != NULL) {
 		user_ticks++;
+		t->stats.user_ticks++;
+	}
 #endif
-	else
+	else {
 		kernel_ticks++;
+		t->stats.kernel_ticks++;
+	}
+
+	if (thread_mlfqs)
+		mlfqs_tick (t);
 
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	thread_ticks++;
+	if (thread_cfs ? cfs_slice_expired (t) : thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
 }
 
-static bool 
-thread_order_sleep_list(const struct list_elem * a,const struct list_elem * b,
-void * aux UNUSED){
+/* Timer callback that wakes up thread T_, which went to sleep
+   in thread_sleep().  Runs in the timer interrupt. */
+static void
+thread_sleep_expired (struct timer_event *ev UNUSED, void *t_) {
+	struct thread *t = t_;
 
-	struct thread * t1  = list_entry(a,struct thread, elem);
-	struct thread * t2 = list_entry(b,struct thread,elem);
-	
-	return t1->wakeup_tick < t2->wakeup_tick;
+	thread_unblock (t);
+	if (!thread_cfs && t->priority > thread_current ()->priority)
+		intr_yield_on_return ();
 }
-/* Change the state of the current thread to BLOCKED if the
-current thread is not idle thread and call schedule () */
-void 
-thread_sleep(int64_t ticks){
+
+/* Blocks the current thread until the timer reaches
+   WAKEUP_TICK.  Interrupts must be off.  The idle thread never
+   sleeps. */
+void
+thread_sleep (int64_t wakeup_tick) {
 	struct thread *curr = thread_current ();
 
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (curr != idle_thread);
 
-	if (curr != idle_thread){
-		int64_t wakeup_tick =  ticks;
-		curr->wakeup_tick = wakeup_tick;
-		global_tick = MIN(global_tick,wakeup_tick);
-		list_insert_ordered (&sleep_list, &curr->elem,thread_order_sleep_list,NULL);
-		curr->in_sleep = true;
-	}
+	timer_add (&curr->sleep_timer, wakeup_tick, thread_sleep_expired, curr);
+	sched_trace (SCHED_EV_SLEEP, curr->tid, THREAD_RUNNING, THREAD_BLOCKED,
+			curr->priority);
 	do_schedule (THREAD_BLOCKED);
+}
 
+/* Adds the time T just spent in the ready queue, which it is
+   leaving, to its statistics. */
+static void
+account_ready_wait (struct thread *t) {
+	uint64_t cycles = rdtsc () - t->ready_since;
+	uint64_t kcycles = cycles >> 10;
+	int bucket = kcycles < 2 ? 0 : 63 - __builtin_clzll (kcycles);
+
+	t->stats.ready_waits++;
+	t->stats.ready_cycles += cycles;
+	t->stats.ready_hist[MIN (bucket, THREAD_STATS_BUCKETS - 1)]++;
+}
+
+/* Copies the running thread's statistics into STATS. */
+void
+thread_get_stats (struct thread_stats *stats) {
+	enum intr_level old_level = intr_disable ();
+	*stats = thread_current ()->stats;
+	intr_set_level (old_level);
+}
+
+/* Prints T's statistics, including the nonempty buckets of its
+   ready-latency histogram. */
+static void
+print_thread_stats (struct thread *t) {
+	const struct thread_stats *s = &t->stats;
+	int i;
+
+	printf ("%s (tid %d): %lld kernel ticks, %lld user ticks, "
+			"%lld voluntary and %lld involuntary switches\n",
+			t->name, t->tid, s->kernel_ticks, s->user_ticks,
+			s->voluntary_switches, s->involuntary_switches);
+	printf ("%s (tid %d): %lld ready waits, %llu cycles total\n",
+			t->name, t->tid, s->ready_waits, s->ready_cycles);
+	for (i = 0; i < THREAD_STATS_BUCKETS; i++)
+		if (s->ready_hist[i] != 0)
+			printf ("  %6llu kcycles and up: %u\n",
+					i == 0 ? 0ULL : 1ULL << i, s->ready_hist[i]);
 }
 
 /* Prints thread statistics. */
@@ -217,6 +360,10 @@ void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread: %lld of %lld pages reused from the thread cache\n",
+			thread_cache_hits, thread_cache_hits + thread_cache_misses);
+	printf ("Thread: %lld wakeups handed the CPU straight to the wakee\n",
+			handoff_cnt);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -237,36 +384,54 @@ thread_print_stats (void) {
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
+	struct switch_threads_frame *sf;
 	struct thread *t;
 	tid_t tid;
 
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = thread_page_get ();
 	if (t == NULL)
 		return TID_ERROR;
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
-	
 
-	/* Call the kernel_thread if it scheduled.
-	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
-	t->tf.rip = (uintptr_t) kernel_thread;
-	t->tf.R.rdi = (uint64_t) function;
-	t->tf.R.rsi = (uint64_t) aux;
-	t->tf.ds = SEL_KDSEG;
-	t->tf.es = SEL_KDSEG;
-	t->tf.ss = SEL_KDSEG;
-	t->tf.cs = SEL_KCSEG;
-	t->tf.eflags = FLAG_IF;
+	/* Under the MLFQS, the new thread inherits its parent's nice
+	   and recent_cpu, and PRIORITY is ignored. */
+	if (thread_mlfqs) {
+		struct thread *curr = thread_current ();
+		enum intr_level old_level = intr_disable ();
+
+		mlfqs_decay_recent_cpu (curr);
+		t->nice = curr->nice;
+		t->recent_cpu = curr->recent_cpu;
+		t->recent_cpu_epoch = curr->recent_cpu_epoch;
+		mlfqs_update_priority (t);
+		mlfqs_park (t);
+		priority = t->priority;
+		intr_set_level (old_level);
+	}
+
+	/* Build a frame for switch_threads() that "returns" into
+	 * switch_entry(), which calls kernel_thread (FUNCTION, AUX).
+	 * Above it is a null return address for kernel_thread, which
+	 * leaves the stack aligned as if kernel_thread were called. */
+	sf = (struct switch_threads_frame *) (t->stack - sizeof (void *)) - 1;
+	*(void **) (t->stack - sizeof (void *)) = NULL;
+	memset (sf, 0, sizeof *sf);
+	sf->rbx = (uint64_t) kernel_thread;
+	sf->r12 = (uint64_t) function;
+	sf->r13 = (uint64_t) aux;
+	sf->rip = switch_entry;
+	t->stack = (uint8_t *) sf;
 
 	/* Add to run queue. */
 	thread_unblock (t);
 
-	if(priority > running_thread ()->priority){
+	if(!thread_cfs && priority > running_thread ()->priority){
 		thread_yield();
 	}
 
@@ -284,6 +449,8 @@ thread_block (void) {
 	
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	sched_trace (SCHED_EV_BLOCK, thread_tid (), THREAD_RUNNING, THREAD_BLOCKED,
+			thread_get_priority ());
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -296,28 +463,69 @@ thread_block (void) {
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
    update other data. */
+void
+thread_unblock (struct thread *t) {
+	enum intr_level old_level;
 
+	ASSERT (is_thread (t));
 
-bool 
-thread_order_ready_list(const struct list_elem * a,const struct list_elem * b,
-void * aux UNUSED){
-
-	struct thread * t1  = list_entry(a,struct thread, elem);
-	struct thread * t2 = list_entry(b,struct thread,elem);
-	
-	return t1->priority > t2->priority;
+	old_level = intr_disable ();
+	ASSERT (t->status == THREAD_BLOCKED);
+	if (thread_mlfqs) {
+		list_remove (&t->mlfqs_elem);
+		mlfqs_decay_recent_cpu (t);
+		mlfqs_update_priority (t);
+	}
+	ready_queue_push (t);
+	t->status = THREAD_READY;
+	sched_trace (SCHED_EV_UNBLOCK, t->tid, THREAD_BLOCKED, THREAD_READY,
+			t->priority);
+	intr_set_level (old_level);
 }
 
+/* Transitions blocked thread T to the ready-to-run state, like
+   thread_unblock(), and lets T run at once if it outranks the
+   running thread.
+
+   Called from a thread, this hands the CPU directly to T: the
+   running thread goes to the head of the ready queue for its
+   priority, so that it resumes ahead of its equals once T
+   blocks again, and T never enters a ready queue.  That saves
+   queueing T only to dequeue it again, and queueing the running
+   thread a second time through thread_yield().  Called from an
+   interrupt handler, this queues T and preempts the running
+   thread when the handler returns.  Under the CFS, which
+   ignores priorities, this is just thread_unblock(). */
 void
-thread_unblock (struct thread *t) {
+thread_wake (struct thread *t) {
+	struct thread *curr = running_thread ();
 	enum intr_level old_level;
 
 	ASSERT (is_thread (t));
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem,thread_order_ready_list,NULL);
-	t->status = THREAD_READY;
+	if (thread_mlfqs) {
+		list_remove (&t->mlfqs_elem);
+		mlfqs_decay_recent_cpu (t);
+		mlfqs_update_priority (t);
+	}
+	sched_trace (SCHED_EV_UNBLOCK, t->tid, THREAD_BLOCKED, THREAD_READY,
+			t->priority);
+
+	if (thread_cfs || t->priority <= curr->priority || intr_context ()) {
+		ready_queue_push (t);
+		t->status = THREAD_READY;
+		if (!thread_cfs && t->priority > curr->priority)
+			intr_yield_on_return ();
+	} else {
+		t->status = THREAD_READY;
+		if (curr != idle_thread)
+			ready_queue_push_front (curr);
+		curr->status = THREAD_READY;
+		handoff_cnt++;
+		schedule_to (t);
+	}
 	intr_set_level (old_level);
 }
 
@@ -373,6 +581,10 @@ thread_exit (void) {
 	process_exit ();
 #endif
 
+	if (thread_exit_stats)
+		print_thread_stats (thread_current ());
+	malloc_drain ();
+
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
@@ -392,135 +604,108 @@ thread_yield (void) {
 
 	old_level = intr_disable ();
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem,thread_order_ready_list,NULL);
+		ready_queue_push (curr);
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
 
-static struct list_elem *
-wakeup(void * aux){
-	struct thread * t = (struct thread *) aux;
-	struct list_elem * tmp = NULL;
-	ASSERT (intr_get_level () == INTR_OFF);
-	int64_t wakeup_tick = t->wakeup_tick;
-
-	if(wakeup_tick == global_tick){
-		t->status = THREAD_READY;
-		t->in_sleep = false;
-		tmp = in_sleep_thread_remove(&t->elem);
-		list_insert_ordered(&ready_list, &t->elem,thread_order_ready_list,NULL);
-	}
-	
-	return tmp;
-}
-
-static void 
-thread_wake_lst(void){
-	ASSERT (intr_get_level () == INTR_OFF);
-	struct list_elem * tmp;
-
-	struct list_elem * e;
-	for(e = list_begin(&sleep_list);e != list_end(&sleep_list);)
-	{
-		struct thread * t = list_entry(e,struct thread,elem);
-		struct thread * t2;
-		
-		tmp = wakeup(t);
+/* Yields the CPU to the ready thread whose tid is TID, ahead of
+   other ready threads of its priority, as long as none outranks
+   it.  The running thread goes to the back of its ready queue,
+   as with thread_yield().  Meant for a producer that wants its
+   consumer to run next.  Returns true if the CPU went to TID;
+   otherwise, if TID is not ready or another ready thread
+   outranks it, or under the CFS, just yields and returns
+   false. */
+bool
+thread_yield_to (tid_t tid) {
+	struct thread *curr = thread_current ();
+	struct thread *t = NULL;
+	enum intr_level old_level;
 
-		if(tmp){
-			t2 = list_entry(tmp,struct thread,elem);
-		}
-		
-		// the same wake up time as the prev thread
-		if(tmp && t != t2 && t->wakeup_tick == t2->wakeup_tick){
-			e = tmp;
-		}
-		// wake up time not yet
-		else{
-			break;
-		}
+	ASSERT (!intr_context ());
 
+	old_level = intr_disable ();
+	if (!thread_cfs) {
+		t = ready_queue_find (tid);
+		if (t != NULL && t->priority < ready_queue_max_priority ())
+			t = NULL;
 	}
-}
-
-void
-thread_wakeup(int64_t curr_tick) {
-
-	if(!list_empty(&sleep_list)){
-		
-		if(curr_tick == global_tick){
-			thread_wake_lst();
-
-			if(!list_empty(&sleep_list)){
-				struct list_elem * e = list_front(&sleep_list);
-				struct thread * t = list_entry(e,struct thread,elem);
-				global_tick = t->wakeup_tick;
-		    }
-		
-			else{
-				global_tick = UINT32_MAX;
-			}
+	if (curr != idle_thread)
+		ready_queue_push (curr);
+	if (t != NULL) {
+		ready_queue_remove (t);
+		account_ready_wait (t);
+		curr->status = THREAD_READY;
+		schedule_to (t);
+	} else
+		do_schedule (THREAD_READY);
+	intr_set_level (old_level);
 
-		}
-			
-	}
+	return t != NULL;
 }
 
-
-
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
 
-	struct thread * curr_thread = thread_current ();	
-	struct list * donation_list_ptr = &curr_thread->donation_list;
-	struct list * waiters_list;
-	struct list_elem * e;
-	struct list_elem *n;
-	struct lock * tmp;
-	struct thread * t;
-
-	for(e = list_begin(donation_list_ptr);e != list_end(donation_list_ptr);e = list_next(e)){
-		tmp = list_entry(e,struct lock,elem);
-		tmp->priority = tmp->holder_priority = new_priority;
-	
-		waiters_list = &tmp->semaphore.waiters;
-		for(n = list_begin(waiters_list);n != list_end(waiters_list);n = list_next(n)){
-			t = list_entry(n,struct thread,elem);
-			if(t->priority > new_priority){
-				tmp->priority = t->priority;
-				break;
-			}
-		}
-		
-	}
+	/* The MLFQS computes priorities itself, and the CFS ignores
+	   them. */
+	if (thread_mlfqs || thread_cfs)
+		return;
 
-	if(!list_empty(&curr_thread->donation_list)){
-		struct lock * lck = list_entry(list_front(&curr_thread->donation_list),struct lock,elem);
-		lock_update_priority(lck);
-	}
+	old_level = intr_disable ();
+	curr->base_priority = new_priority;
+	thread_refresh_priority (curr);
+	intr_set_level (old_level);
 
-	else{
-		curr_thread->priority = new_priority;
-	}
+	/* Yield if a ready thread now outranks us. */
+	if (curr->priority < ready_queue_max_priority ())
+		thread_yield ();
+}
 
-	// adjust the ready list
-	if(!list_empty(&ready_list))
-	{
-		int max_priority = list_entry(list_front(&ready_list),struct thread,elem)->priority;
+/* Recomputes T's priority: its base priority, raised to the
+   highest priority donated through the locks T holds.  If T is
+   ready, moves it to the ready queue for its new priority; if it
+   is waiting on a semaphore or condition variable, moves it to
+   its new place among the waiters.  Returns true if the priority
+   changed.  Interrupts must be off. */
+bool
+thread_refresh_priority (struct thread *t) {
+	struct pq_elem *top = pq_top (&t->held_locks);
+	int priority = t->base_priority;
 
-		if (new_priority < max_priority){
-			thread_yield();
-		}
+	ASSERT (intr_get_level () == INTR_OFF);
 
+	if (top != NULL)
+		priority = MAX (priority,
+				lock_priority (pq_entry (top, struct lock, elem)));
+	if (priority == t->priority)
+		return false;
+
+	if (t->status == THREAD_READY && !thread_cfs) {
+		uint64_t ready_since = t->ready_since;
+
+		ready_queue_remove (t);
+		t->priority = priority;
+		ready_queue_push (t);
+		t->ready_since = ready_since;
+	} else {
+		t->priority = priority;
+		sema_requeue (t);
 	}
-	
-
+	return true;
 }
 
-
-
-
+/* Orders threads by priority, for a lock's waiters. */
+bool
+thread_priority_less (const struct pq_elem *a, const struct pq_elem *b,
+		void *aux UNUSED) {
+	return pq_entry (a, struct thread, donor_elem)->priority
+		< pq_entry (b, struct thread, donor_elem)->priority;
+}
 
 /* Returns the current thread's priority. */
 int
@@ -528,58 +713,183 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority, and yields if it is no longer the highest. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
 	enum intr_level old_level;
 
 	old_level = intr_disable ();
-	thread_current ()->nice = nice;
-	//mlfqs_update_priority(thread_current());
+	mlfqs_decay_recent_cpu (curr);
+	if (thread_cfs)
+		cfs_charge (curr);
+	curr->nice = nice;
+	if (thread_mlfqs)
+		mlfqs_update_priority (curr);
 	intr_set_level (old_level);
+
+	if (curr->priority < ready_queue_max_priority ())
+		thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	enum intr_level old_level;
-
-	old_level = intr_disable ();
-	int nice = thread_current()->nice;
-	intr_set_level (old_level);
-
-	return nice;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	enum intr_level old_level;
+	unsigned seq;
+	int avg;
 
-	old_level = intr_disable ();
+	do {
+		seq = seqlock_read_begin (&load_avg_seqlock);
+		avg = load_avg;
+	} while (seqlock_read_retry (&load_avg_seqlock, seq));
 
-	int avg = mul_fixed_pt_with_int(load_avg,100);
-	int load_avg_int = fixed_pt_to_int_nearest(avg);
-	intr_set_level (old_level);
-	
-	return load_avg_int;
+	return fixed_pt_to_int_nearest (mul_fixed_pt_with_int (avg, 100));
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
+	struct thread *curr = thread_current ();
 	enum intr_level old_level;
+	int recent_cpu_100;
 
 	old_level = intr_disable ();
-
-	int r_cpu = mul_fixed_pt_with_int(thread_current()->recent_cpu,100);
-	int r_cpu_int = fixed_pt_to_int_nearest(r_cpu);
+	mlfqs_decay_recent_cpu (curr);
+	recent_cpu_100 = fixed_pt_to_int_nearest (mul_fixed_pt_with_int (curr->recent_cpu, 100));
 	intr_set_level (old_level);
-	return r_cpu_int;
+
+	return recent_cpu_100;
+}
+
+/* Applies the recent_cpu decays of every second that has ended
+   since T's recent_cpu was last brought up to date. */
+static void
+mlfqs_decay_recent_cpu (struct thread *t) {
+	int64_t epoch = t->recent_cpu_epoch;
+	int nice = int_to_fixed_pt (t->nice);
+
+	/* Parking keeps every thread within reach of the history. */
+	ASSERT (mlfqs_epoch - epoch <= MLFQS_HISTORY);
+	for (epoch++; epoch <= mlfqs_epoch; epoch++)
+		t->recent_cpu = add_fixed_pts (mul_fixed_pts (
+					decay_history[epoch % MLFQS_HISTORY], t->recent_cpu), nice);
+	t->recent_cpu_epoch = mlfqs_epoch;
+}
+
+/* Recomputes T's priority from its (up-to-date) recent_cpu and
+   nice values.  Does not move T between ready queues. */
+static void
+mlfqs_update_priority (struct thread *t) {
+	int priority = PRI_MAX
+		- fixed_pt_to_int_zero (div_fixed_pt_with_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	t->priority = MAX (PRI_MIN, MIN (PRI_MAX, priority));
+}
+
+/* Adds blocked thread T to the parked threads of its epoch. */
+static void
+mlfqs_park (struct thread *t) {
+	list_push_back (&mlfqs_parked[t->recent_cpu_epoch % MLFQS_HISTORY],
+			&t->mlfqs_elem);
+}
+
+/* Updates load_avg at the end of a second and records the
+   recent_cpu decay factor for the new epoch.  CURR is the
+   running thread. */
+static void
+mlfqs_update_load_avg (struct thread *curr) {
+	int ready_threads = ready_cnt + (curr != idle_thread ? 1 : 0);
+	struct list *parked;
+	int twice_load;
+
+	seqlock_write_begin (&load_avg_seqlock);
+	load_avg = add_fixed_pts (
+			div_fixed_pt_with_int (mul_fixed_pt_with_int (load_avg, 59), 60),
+			div_fixed_pt_with_int (int_to_fixed_pt (ready_threads), 60));
+	seqlock_write_end (&load_avg_seqlock);
+
+	/* The new epoch's factor replaces that of MLFQS_HISTORY
+	   epochs ago, which threads parked since then still need. */
+	parked = &mlfqs_parked[(mlfqs_epoch + 1) % MLFQS_HISTORY];
+	while (!list_empty (parked)) {
+		struct thread *t = list_entry (list_pop_front (parked),
+				struct thread, mlfqs_elem);
+		mlfqs_decay_recent_cpu (t);
+		mlfqs_park (t);
+	}
+
+	twice_load = mul_fixed_pt_with_int (load_avg, 2);
+	mlfqs_epoch++;
+	decay_history[mlfqs_epoch % MLFQS_HISTORY] =
+		div_fixed_pts (twice_load, add_fixed_pt_with_int (1, twice_load));
+}
+
+/* Work function that brings every ready thread's recent_cpu and
+   priority up to date and moves it to the ready queue for its
+   new priority, then has the running thread yield if a ready
+   thread now outranks it.  Threads keep their relative order.
+
+   Interrupts are let in between threads.  That is safe because
+   no thread runs until deferred work is done, and interrupt
+   handlers only ever add threads to the ready queues.  ready_cnt
+   keeps counting the threads taken out meanwhile, so that
+   load_avg does not miss them. */
+static void
+mlfqs_refresh_ready (void *aux UNUSED) {
+	struct thread *curr = thread_current ();
+	struct list ready;
+	int pri;
+
+	list_init (&ready);
+	intr_disable ();
+	while (ready_mask != 0) {
+		pri = ready_queue_max_priority ();
+		list_splice (list_end (&ready), list_begin (&ready_queues[pri]),
+				list_end (&ready_queues[pri]));
+		ready_mask &= ~(1ULL << pri);
+	}
+
+	while (!list_empty (&ready)) {
+		struct thread *t = list_entry (list_pop_front (&ready), struct thread, elem);
+		mlfqs_decay_recent_cpu (t);
+		mlfqs_update_priority (t);
+		ready_cnt--;
+		ready_queue_push (t);
+		intr_enable ();
+		intr_disable ();
+	}
+
+	if (curr != idle_thread)
+		mlfqs_update_priority (curr);
+	if (ready_queue_max_priority () > curr->priority)
+		intr_yield_on_return ();
+	intr_enable ();
+}
+
+/* MLFQS work for one timer tick, with CURR running.  Only CURR
+   and the ready threads are touched, never the blocked ones. */
+static void
+mlfqs_tick (struct thread *curr) {
+	int64_t now = timer_ticks ();
+
+	if (curr != idle_thread) {
+		mlfqs_decay_recent_cpu (curr);
+		curr->recent_cpu = add_fixed_pt_with_int (1, curr->recent_cpu);
+	}
+
+	if (now % TIMER_FREQ == 0)
+		mlfqs_update_load_avg (curr);
+
+	if (now % 4 == 0)
+		work_queue (&mlfqs_work, WORK_LOW);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -603,6 +913,16 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* With nothing else to run, zero free pages ahead of
+		   demand.  Interrupts are on meanwhile, so a thread that
+		   becomes ready preempts us. */
+		intr_enable ();
+		while (ready_cnt == 0 && palloc_zero_refill ())
+			continue;
+		intr_disable ();
+		if (ready_cnt != 0)
+			continue;
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -614,7 +934,13 @@ idle (void *idle_started_ UNUSED) {
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
+		   7.11.1 "HLT Instruction".
+
+		   With tickless idle, the periodic timer interrupt is
+		   first replaced by a one-shot one for the next timer
+		   event, so that the halt is not cut short every tick. */
+		timer_idle_enter ();
+		intr_off_end ();
 		asm volatile ("sti; hlt" : : : "memory");
 	}
 }
@@ -641,13 +967,159 @@ init_thread (struct thread *t, const char *name, int priority) {
 	memset (t, 0, sizeof *t);
 	t->status = THREAD_BLOCKED;
 	strlcpy (t->name, name, sizeof t->name);
-	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
-	t->priority = priority;
+	t->stack = (uint8_t *) t + PGSIZE;
+	t->priority = t->base_priority = priority;
 	t->nice = 0;
 	t->recent_cpu = 0;
-	list_init(&t->donation_list);
+	t->recent_cpu_epoch = mlfqs_epoch;
+	pq_init (&t->held_locks, lock_priority_less, NULL);
 	t->magic = THREAD_MAGIC;
-	list_push_back(&thread_list,&t->all_elem);
+}
+
+/* Appends T to the back of the ready queue for its priority,
+   behind any threads of equal priority that are already ready. */
+static void
+ready_queue_push (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	if (thread_cfs) {
+		/* A running thread that yields is charged first, so that
+		   its key is current.  A new or waking thread starts at
+		   the floor, so it cannot monopolize the CPU to catch
+		   up. */
+		if (t == running_thread ())
+			cfs_charge (t);
+		if (t->vruntime < cfs_min_vruntime)
+			t->vruntime = cfs_min_vruntime;
+		rb_insert (&cfs_tree, &t->cfs_node);
+		cfs_load += cfs_weight (t);
+	} else {
+		list_push_back (&ready_queues[t->priority], &t->elem);
+		ready_mask |= 1ULL << t->priority;
+	}
+	ready_cnt++;
+	t->ready_since = rdtsc ();
+}
+
+/* Puts T at the front of the ready queue for its priority, ahead
+   of any threads of equal priority, for a running thread that is
+   preempted before its slice is up.  Not for the CFS. */
+static void
+ready_queue_push_front (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+	ASSERT (!thread_cfs);
+
+	list_push_front (&ready_queues[t->priority], &t->elem);
+	ready_mask |= 1ULL << t->priority;
+	ready_cnt++;
+	t->ready_since = rdtsc ();
+}
+
+/* Removes ready thread T from its ready queue. */
+static void
+ready_queue_remove (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_READY);
+	ASSERT (!thread_cfs);
+
+	list_remove (&t->elem);
+	if (list_empty (&ready_queues[t->priority]))
+		ready_mask &= ~(1ULL << t->priority);
+	ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread, or
+   PRI_MIN - 1 if no thread is ready. */
+static int
+ready_queue_max_priority (void) {
+	if (ready_mask == 0)
+		return PRI_MIN - 1;
+	return 63 - __builtin_clzll (ready_mask);
+}
+
+/* Returns the thread in the ready queues whose tid is TID, or a
+   null pointer if there is none.  Searches from the highest
+   priority down.  Not for the CFS. */
+static struct thread *
+ready_queue_find (tid_t tid) {
+	uint64_t mask;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!thread_cfs);
+
+	for (mask = ready_mask; mask != 0; ) {
+		int pri = 63 - __builtin_clzll (mask);
+		struct list_elem *e;
+
+		for (e = list_begin (&ready_queues[pri]); e != list_end (&ready_queues[pri]);
+				e = list_next (e)) {
+			struct thread *t = list_entry (e, struct thread, elem);
+			if (t->tid == tid)
+				return t;
+		}
+		mask &= ~(1ULL << pri);
+	}
+	return NULL;
+}
+
+/* Orders threads in the CFS tree by vruntime. */
+static bool
+cfs_less (const struct rb_node *a_, const struct rb_node *b_,
+		void *aux UNUSED) {
+	const struct thread *a = rb_entry (a_, struct thread, cfs_node);
+	const struct thread *b = rb_entry (b_, struct thread, cfs_node);
+
+	return a->vruntime < b->vruntime;
+}
+
+/* Returns T's CFS weight, from its nice value. */
+static uint32_t
+cfs_weight (const struct thread *t) {
+	int idx = t->nice + 20;
+	int last = sizeof cfs_nice_weight / sizeof *cfs_nice_weight - 1;
+
+	return cfs_nice_weight[MAX (0, MIN (last, idx))];
+}
+
+/* Charges running thread CURR for the CPU time it used since the
+   last charge and advances cfs_min_vruntime. */
+static void
+cfs_charge (struct thread *curr) {
+	uint64_t now = rdtsc ();
+	uint64_t min = UINT64_MAX;
+
+	if (curr != idle_thread) {
+		curr->vruntime += (now - cfs_exec_start) * CFS_NICE_0_WEIGHT
+			/ cfs_weight (curr);
+		if (curr->status == THREAD_RUNNING)
+			min = curr->vruntime;
+	}
+	cfs_exec_start = now;
+
+	if (!rb_empty (&cfs_tree)) {
+		struct thread *first = rb_entry (rb_min (&cfs_tree),
+				struct thread, cfs_node);
+		min = MIN (min, first->vruntime);
+	}
+	if (min != UINT64_MAX && min > cfs_min_vruntime)
+		cfs_min_vruntime = min;
+}
+
+/* Charges running thread CURR for the tick that just ended and
+   returns true if it has used up its slice. */
+static bool
+cfs_slice_expired (struct thread *curr) {
+	uint64_t weight, slice;
+
+	cfs_charge (curr);
+	if (curr == idle_thread)
+		return !rb_empty (&cfs_tree);
+
+	weight = cfs_weight (curr);
+	slice = CFS_LATENCY * weight / (cfs_load + weight);
+	return thread_ticks >= MAX (slice, CFS_MIN_GRANULARITY);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -657,10 +1129,32 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
+	struct list *queue;
+	struct thread *t;
+	int pri;
+
+	if (thread_cfs) {
+		if (rb_empty (&cfs_tree))
+			return idle_thread;
+		t = rb_entry (rb_min (&cfs_tree), struct thread, cfs_node);
+		rb_remove (&cfs_tree, &t->cfs_node);
+		cfs_load -= cfs_weight (t);
+		ready_cnt--;
+		account_ready_wait (t);
+		return t;
+	}
+
+	if (ready_mask == 0)
 		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+	pri = ready_queue_max_priority ();
+	queue = &ready_queues[pri];
+	t = list_entry (list_pop_front (queue), struct thread, elem);
+	if (list_empty (queue))
+		ready_mask &= ~(1ULL << pri);
+	ready_cnt--;
+	account_ready_wait (t);
+	return t;
 }
 
 /* Use iretq to launch the thread */
@@ -691,73 +1185,21 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches from the running thread to TH.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   Both threads are in the kernel, so this saves only the
+   callee-saved registers and the stack pointer and resumes TH
+   with a plain `ret' (see switch.S).  A thread that was
+   interrupted still returns through its interrupt frame, and
+   user mode is still entered with do_iret().
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
    added at the end of the function. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
-
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	switch_threads (&running_thread ()->stack, th->stack);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -771,7 +1213,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		thread_page_put (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -780,7 +1222,20 @@ do_schedule(int status) {
 static void
 schedule (void) {
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+
+	/* A yielding thread was already charged when it was queued. */
+	if (thread_cfs && curr->status != THREAD_READY)
+		cfs_charge (curr);
+	if (thread_mlfqs && curr->status == THREAD_BLOCKED && curr != idle_thread)
+		mlfqs_park (curr);
+	schedule_to (next_thread_to_run ());
+}
+
+/* Switches from the running thread, whose status must already
+   be updated, to NEXT, which must not be in a ready queue. */
+static void
+schedule_to (struct thread *next) {
+	struct thread *curr = running_thread ();
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
@@ -797,6 +1252,16 @@ schedule (void) {
 #endif
 
 	if (curr != next) {
+		if (curr->status == THREAD_READY)
+			curr->stats.involuntary_switches++;
+		else
+			curr->stats.voluntary_switches++;
+
+		sched_trace (SCHED_EV_SWITCH, curr->tid, THREAD_RUNNING, curr->status,
+				curr->priority);
+		sched_trace (SCHED_EV_SWITCH, next->tid, THREAD_READY, THREAD_RUNNING,
+				next->priority);
+
 		/* If the thread we switched from is dying, destroy its struct
 		   thread. This must happen late so that thread_exit() doesn't
 		   pull out the rug under itself.
@@ -807,7 +1272,6 @@ schedule (void) {
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
 			ASSERT (curr != next);
 			list_push_back (&destruction_req, &curr->elem);
-			list_remove(&curr->all_elem); // delete from thread_list
 		}
 
 		/* Before switching the thread, we first save the information
@@ -816,15 +1280,49 @@ schedule (void) {
 	}
 }
 
-/* Returns a tid to use for a new thread. */
+/* Returns a tid to use for a new thread.  A single atomic
+   increment, so it needs no lock. */
 static tid_t
 allocate_tid (void) {
 	static tid_t next_tid = 1;
-	tid_t tid;
 
-	lock_acquire (&tid_lock);
-	tid = next_tid++;
-	lock_release (&tid_lock);
+	return __atomic_fetch_add (&next_tid, 1, __ATOMIC_RELAXED);
+}
+
+/* Returns a page for a new thread, preferably a dead thread's
+   page from the cache, or a null pointer if memory is
+   exhausted.  A fresh page comes zeroed, from the palloc stock
+   of pre-zeroed pages when it has one; a cached page is not,
+   but init_thread() clears the struct thread and the rest is
+   stack. */
+static struct thread *
+thread_page_get (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level;
 
-	return tid;
+	old_level = intr_disable ();
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+		thread_cache_hits++;
+	} else
+		thread_cache_misses++;
+	intr_set_level (old_level);
+
+	if (t == NULL)
+		t = palloc_get_page (PAL_ZERO);
+	return t;
+}
+
+/* Puts dead thread T's page into the cache, or frees it if the
+   cache is full.  Interrupts must be off. */
+static void
+thread_page_put (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (thread_cache_cnt < THREAD_CACHE_MAX) {
+		list_push_front (&thread_cache, &t->elem);
+		thread_cache_cnt++;
+	} else
+		palloc_free_page (t);
 }
@@ -1,15 +1,29 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <clock.h>
 #include <syscall-nr.h>
+#include "threads/futex.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
+static bool user_mapped (const void *, size_t, uint64_t pte_flags);
+static bool user_writable (void *, size_t);
+static int *futex_kaddr (int *uaddr);
+static int sys_thread_stats (struct thread_stats *);
+static int sys_futex_wait (int *uaddr, int expected, int64_t timeout_ms);
+static int sys_futex_wake (int *uaddr, int wake_cnt);
+static int sys_clock_gettime (int clock, struct timespec *);
+static int sys_nanosleep (const struct timespec *);
 
 /* System call.
  *
@@ -39,8 +53,145 @@ syscall_init (void) {
 
 /* The main system call interface */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
+syscall_handler (struct intr_frame *f) {
+	switch (f->R.rax) {
+		case SYS_THREAD_STATS:
+			f->R.rax = sys_thread_stats ((struct thread_stats *) f->R.rdi);
+			return;
+		case SYS_FUTEX_WAIT:
+			f->R.rax = sys_futex_wait ((int *) f->R.rdi, f->R.rsi, f->R.rdx);
+			return;
+		case SYS_FUTEX_WAKE:
+			f->R.rax = sys_futex_wake ((int *) f->R.rdi, f->R.rsi);
+			return;
+		case SYS_CLOCK_GETTIME:
+			f->R.rax = sys_clock_gettime (f->R.rdi, (struct timespec *) f->R.rsi);
+			return;
+		case SYS_NANOSLEEP:
+			f->R.rax = sys_nanosleep ((const struct timespec *) f->R.rdi);
+			return;
+	}
+
 	// TODO: Your implementation goes here.
 	printf ("system call!\n");
 	thread_exit ();
 }
+
+/* Returns true if the SIZE bytes at user address UADDR are all
+   mapped in the current process with every bit in PTE_FLAGS
+   set.  A range that wraps past the top of the address space
+   is rejected before the walk, whose loop bound would wrap
+   too. */
+static bool
+user_mapped (const void *uaddr, size_t size, uint64_t pte_flags) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	const void *page;
+
+	if (size == 0)
+		return true;
+	if ((uintptr_t) uaddr + size < (uintptr_t) uaddr
+			|| !is_user_vaddr (uaddr + size - 1))
+		return false;
+	for (page = pg_round_down (uaddr); page <= uaddr + size - 1;
+			page += PGSIZE) {
+		uint64_t *pte;
+
+		pte = pml4e_walk (pml4, (uint64_t) page, 0);
+		if (pte == NULL || (*pte & pte_flags) != pte_flags)
+			return false;
+	}
+	return true;
+}
+
+/* Returns true if the SIZE bytes at user address UADDR are all
+   mapped writable in the current process. */
+static bool
+user_writable (void *uaddr, size_t size) {
+	return user_mapped (uaddr, size, PTE_P | PTE_W);
+}
+
+/* Copies the running thread's scheduling statistics to user
+   buffer STATS.  Returns 0 if successful, -1 if STATS is not a
+   writable user buffer. */
+static int
+sys_thread_stats (struct thread_stats *stats) {
+	struct thread_stats tmp;
+
+	if (!user_writable (stats, sizeof *stats))
+		return -1;
+	thread_get_stats (&tmp);
+	*stats = tmp;
+	return 0;
+}
+
+/* Returns the kernel address through which the int at user
+   address UADDR can be used as a futex, or a null pointer if
+   UADDR is misaligned or not mapped in the current process. */
+static int *
+futex_kaddr (int *uaddr) {
+	int *kaddr;
+
+	if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+		return NULL;
+	kaddr = pml4_get_page (thread_current ()->pml4, uaddr);
+	if (kaddr == NULL || !futex_valid (kaddr))
+		return NULL;
+	return kaddr;
+}
+
+/* Sleeps on the futex at user address UADDR, as futex_wait().
+   Returns FUTEX_FAULT if UADDR is not a mapped, aligned user
+   address. */
+static int
+sys_futex_wait (int *uaddr, int expected, int64_t timeout_ms) {
+	int *kaddr = futex_kaddr (uaddr);
+
+	return kaddr != NULL ? futex_wait (kaddr, expected, timeout_ms) : FUTEX_FAULT;
+}
+
+/* Wakes threads sleeping on the futex at user address UADDR, as
+   futex_wake().  Returns FUTEX_FAULT if UADDR is not a mapped,
+   aligned user address. */
+static int
+sys_futex_wake (int *uaddr, int wake_cnt) {
+	int *kaddr = futex_kaddr (uaddr);
+
+	return kaddr != NULL ? futex_wake (kaddr, wake_cnt) : FUTEX_FAULT;
+}
+
+/* Stores the time of CLOCK in user buffer TS.  Returns 0 if
+   successful, -1 if CLOCK is unknown or TS is not a writable
+   user buffer. */
+static int
+sys_clock_gettime (int clock, struct timespec *ts) {
+	uint64_t ns;
+
+	if (clock != CLOCK_MONOTONIC || !user_writable (ts, sizeof *ts))
+		return -1;
+	ns = timer_clock_ns ();
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+	return 0;
+}
+
+/* Sleeps for the duration in user buffer TS.  Returns 0 if
+   successful, -1 if TS is not a readable user buffer or holds
+   an invalid duration.  Durations too long to count in
+   nanoseconds sleep forever. */
+static int
+sys_nanosleep (const struct timespec *ts) {
+	struct timespec tmp;
+	int64_t ns;
+
+	if (!user_mapped (ts, sizeof *ts, PTE_P))
+		return -1;
+	tmp = *ts;
+	if (tmp.tv_sec < 0 || tmp.tv_nsec < 0 || tmp.tv_nsec >= 1000000000)
+		return -1;
+	if (tmp.tv_sec >= INT64_MAX / 1000000000)
+		ns = INT64_MAX;
+	else
+		ns = tmp.tv_sec * 1000000000 + tmp.tv_nsec;
+	timer_nsleep (ns);
+	return 0;
+}